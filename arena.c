@@ -0,0 +1,72 @@
+/*
+   bump pointer arena for records that are freed together
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define ARENA_CHUNK (1 << 20)
+
+struct arena *
+arena_create(TALLOC_CTX *memctx, size_t chunk)
+{
+    struct arena *ar = talloc_zero(memctx, struct arena);
+
+    if (NULL == ar) {
+        fprintf(stderr, "Failed to allocate memory for arena\n");
+        return NULL;
+    }
+    ar->chunk = chunk ? chunk : ARENA_CHUNK;
+    return ar;
+}
+
+void *
+arena_more(struct arena *ar, size_t n)
+{
+    char *p;
+
+    // a record that would waste most of a chunk gets a chunk of its own,
+    // and the current chunk stays in use
+    if (n > ar->chunk / 4) {
+        if (NULL == (p = (char *) talloc_size(ar, n))) {
+            fprintf(stderr, "arena: cannot allocate %zu bytes\n", n);
+            exit(1);
+        }
+        ar->used += n;
+        return p;
+    }
+    if (NULL == (p = (char *) talloc_size(ar, ar->chunk))) {
+        fprintf(stderr, "arena: cannot allocate a chunk of %zu bytes\n", ar->chunk);
+        exit(1);
+    }
+    ar->cur = p + n;
+    ar->end = p + ar->chunk;
+    ar->used += n;
+    return p;
+}
+
+void *
+arena_zalloc(struct arena *ar, size_t n)
+{
+    void *p = arena_alloc(ar, n);
+
+    memset(p, 0, n);
+    return p;
+}
@@ -0,0 +1,61 @@
+/*
+   bump pointer arena for records that are freed together
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PHAT_ARENA_H
+#define PHAT_ARENA_H
+#include <stddef.h>
+#include "talloc.h"
+
+/*
+   Records are carved out of large talloc'd chunks, with no header of
+   their own, and cannot be freed one by one.  Everything goes when the
+   arena is talloc_free()d.  Not thread safe.
+*/
+struct arena {
+    char *cur, *end;            // free part of the current chunk
+    size_t chunk;               // bytes per chunk
+    size_t used;                // bytes handed out
+};
+
+#define ARENA_ALIGN 8
+
+/* create an arena, chunk is the bytes per chunk or 0 */
+struct arena *arena_create(TALLOC_CTX *memctx, size_t chunk);
+
+/* the slow path of arena_alloc */
+void *arena_more(struct arena *ar, size_t n);
+
+/* n bytes, aligned for any of phat's records */
+static inline void *
+arena_alloc(struct arena *ar, size_t n)
+{
+    void *p;
+
+    n = (n + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+    if ((size_t) (ar->end - ar->cur) < n)
+        return arena_more(ar, n);
+    p = ar->cur;
+    ar->cur += n;
+    ar->used += n;
+    return p;
+}
+
+/* n bytes, zeroed */
+void *arena_zalloc(struct arena *ar, size_t n);
+
+#endif /* PHAT_ARENA_H */
@@ -0,0 +1,203 @@
+/*
+   dominator tree and retained sizes over a reference graph
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "domtree.h"
+#include "objtab.h"
+
+static void *
+domtree_array(TALLOC_CTX *ctx, size_t size, size_t n)
+{
+    void *p = talloc_zero_size(ctx, size * (n ? n : 1));
+
+    if (NULL == p) {
+        fprintf(stderr, "domtree: cannot allocate %zu entries\n", n);
+        exit(1);
+    }
+    return p;
+}
+
+/*
+   The links of the forest being compressed, for node v: anc[v] is 0
+   when v is not linked yet, label[v] the node of least semidominator
+   on the compressed path above v.  Walks the path up first, then
+   compresses from the top down, as the recursive version would.
+*/
+static void
+domtree_compress(uint32_t v, uint32_t *anc, uint32_t *label, const uint32_t *semi, uint32_t *stack)
+{
+    size_t sp = 0;
+
+    while (anc[anc[v]]) {
+        stack[sp++] = v;
+        v = anc[v];
+    }
+    while (sp) {
+        uint32_t a;
+
+        v = stack[--sp];
+        a = anc[v];
+        if (semi[label[a]] < semi[label[v]])
+            label[v] = label[a];
+        anc[v] = anc[a];
+    }
+}
+
+struct domtree *
+domtree_build(TALLOC_CTX *memctx, const struct refgraph *g,
+    const struct refgraph *rg, const uint32_t *roots, size_t nroots, const uint64_t *self)
+{
+    struct domtree *dt = talloc_zero(memctx, struct domtree);
+    TALLOC_CTX *tmp = talloc_new(NULL);
+    size_t n = g->n, i, k, sp;
+    uint32_t *pre, *vertex, *parent, *semi, *label, *anc, *dom, *stack;
+    uint64_t *pos, e;
+    struct objset *isroot;
+    struct refgraph *tree;
+
+    if (NULL == dt) {
+        fprintf(stderr, "domtree: cannot allocate\n");
+        exit(1);
+    }
+    dt->n = n;
+
+    // depth first preorder numbers from 1, 0 is unreached, the super root is 1
+    pre = (uint32_t *) domtree_array(tmp, sizeof(uint32_t), n + 1);
+    vertex = (uint32_t *) domtree_array(tmp, sizeof(uint32_t), n + 2);
+    parent = (uint32_t *) domtree_array(tmp, sizeof(uint32_t), n + 2);
+    stack = (uint32_t *) domtree_array(tmp, sizeof(uint32_t), n + 1);
+    pos = (uint64_t *) domtree_array(tmp, sizeof(uint64_t), n + 1);
+    isroot = objset_create(tmp, n + 1);
+    for (i = 0; i < nroots; i++)
+        objset_add(isroot, roots[i]);
+
+    pre[n] = k = 1;
+    vertex[1] = n;
+    stack[0] = n;
+    pos[0] = 0;
+    sp = 1;
+    while (sp) {
+        uint32_t v = stack[sp - 1], c;
+
+        if (n == v) {
+            if (pos[sp - 1] == nroots) {
+                sp--;
+                continue;
+            }
+            c = roots[pos[sp - 1]++];
+        } else {
+            if (pos[sp - 1] == g->first[v + 1]) {
+                sp--;
+                continue;
+            }
+            c = g->to[pos[sp - 1]++];
+        }
+        if (pre[c])
+            continue;
+        pre[c] = ++k;
+        vertex[k] = c;
+        parent[k] = pre[v];
+        stack[sp] = c;
+        pos[sp++] = g->first[c];
+    }
+    talloc_free(pos);
+
+    // semidominators, in decreasing preorder, by preorder number
+    semi = (uint32_t *) domtree_array(tmp, sizeof(uint32_t), k + 1);
+    label = (uint32_t *) domtree_array(tmp, sizeof(uint32_t), k + 1);
+    anc = (uint32_t *) domtree_array(tmp, sizeof(uint32_t), k + 1);
+    for (i = 1; i <= k; i++)
+        semi[i] = label[i] = i;
+    for (i = k; i >= 2; i--) {
+        uint32_t w = vertex[i], s = semi[i];
+
+        // the super root is a predecessor of every root
+        if (objset_test(isroot, w))
+            s = 1;
+        for (e = rg->first[w]; e < rg->first[w + 1] && s > 1; e++) {
+            uint32_t u = pre[rg->to[e]];
+
+            if (0 == u)
+                continue;       // unreached from the roots
+            if (anc[u]) {
+                domtree_compress(u, anc, label, semi, stack);
+                u = semi[label[u]];
+            }
+            if (u < s)
+                s = u;
+        }
+        semi[i] = s;
+        anc[i] = parent[i];
+    }
+    talloc_free(anc);
+    talloc_free(label);
+
+    // the immediate dominator is the nearest common ancestor of the
+    // parent and the semidominator in the tree as built so far
+    dom = parent;
+    for (i = 2; i <= k; i++) {
+        uint32_t d = parent[i];
+
+        while (d > semi[i])
+            d = dom[d];
+        dom[i] = d;
+    }
+
+    dt->nreach = k;
+    dt->idom = (uint32_t *) domtree_array(dt, sizeof(uint32_t), n + 1);
+    dt->retained = (uint64_t *) domtree_array(dt, sizeof(uint64_t), n + 1);
+    dt->order = (uint32_t *) domtree_array(dt, sizeof(uint32_t), k);
+    for (i = 0; i <= n; i++)
+        dt->idom[i] = DOM_NONE;
+    dt->idom[n] = n;
+    for (i = 1; i <= k; i++) {
+        uint32_t v = vertex[i];
+
+        dt->order[i - 1] = v;
+        if (i > 1) {
+            dt->idom[v] = vertex[dom[i]];
+            dt->retained[v] = self[v];
+        }
+    }
+
+    // a node is numbered after its dominator, so the sizes add up going backwards
+    for (i = k; i >= 2; i--)
+        dt->retained[vertex[dom[i]]] += dt->retained[vertex[i]];
+
+    // the tree, children in preorder
+    dt->tree = tree = refgraph_create(dt, n + 1);
+    tree->nedges = k - 1;
+    tree->to = (uint32_t *) domtree_array(tree, sizeof(uint32_t), k);
+    for (i = 2; i <= k; i++)
+        tree->first[vertex[dom[i]] + 1]++;
+    for (i = 0; i <= n; i++)
+        tree->first[i + 1] += tree->first[i];
+    for (i = 2; i <= k; i++) {
+        uint32_t d = vertex[dom[i]];
+        tree->to[tree->first[d]++] = vertex[i];
+    }
+    for (i = n; i > 0; i--)
+        tree->first[i] = tree->first[i - 1];
+    tree->first[0] = 0;
+
+    talloc_free(tmp);
+    return dt;
+}
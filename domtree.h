@@ -0,0 +1,51 @@
+/*
+   dominator tree and retained sizes over a reference graph
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PHAT_DOMTREE_H
+#define PHAT_DOMTREE_H
+#include <stdint.h>
+#include <stddef.h>
+#include "talloc.h"
+#include "refgraph.h"
+
+/*
+   A node d dominates n when every path from the roots to n goes through
+   d, so n, and everything only it leads to, is freed once d is.  The
+   roots hang off a made up super root, node n of the graph, which
+   dominates everything reachable.  Built with semi-NCA: one depth
+   first numbering, semidominators by path compression, then each
+   immediate dominator is the nearest common ancestor of its
+   semidominator and parent in the tree built so far.  Nothing recurses.
+*/
+#define DOM_NONE ((uint32_t) -1)
+
+struct domtree {
+    size_t n;                   // nodes of the graph, the super root is node n
+    uint32_t *idom;             // n + 1 immediate dominators, DOM_NONE when unreachable
+    uint64_t *retained;         // n + 1 bytes freed with the node, itself included
+    uint32_t *order;            // the reachable nodes in depth first preorder, super root first
+    size_t nreach;              // super root included
+    struct refgraph *tree;      // edges from each node to those it immediately dominates
+};
+
+/* build the dominator tree of the graph g, whose reverse is rg, over the
+   given roots, self is the bytes of each of the g->n nodes */
+struct domtree *domtree_build(TALLOC_CTX *memctx, const struct refgraph *g,
+    const struct refgraph *rg, const uint32_t *roots, size_t nroots, const uint64_t *self);
+
+#endif /* PHAT_DOMTREE_H */
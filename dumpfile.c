@@ -0,0 +1,1089 @@
+/*
+   memory mapped access to java hprof dump files
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#if !defined(__sun)
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "dumpfile.h"
+#include "tpool.h"
+
+#define ZWSIZE  32768           // deflate window
+#define ZCHUNK  (1 << 20)       // inflated bytes a cursor holds at once
+#define ZREGION (4 << 20)       // gzip bytes dump_index looks for a member start in
+#define ZRANGE  (64 << 20)      // most gzip bytes of a range the pipeline holds inflated
+#define OFF_MAX ((off_t) (~(unsigned long long) 0 >> 1))
+
+struct dzpoint {                // a place inflate can be restarted from
+    off_t out;                  // dump offset
+    off_t in;                   // offset in the gzip file of the next byte
+    int bits;                   // bits of the byte before in not yet used
+    int member;                 // in is the start of a gzip member, there is no window
+    unsigned int wlen;
+    unsigned char *window;
+};
+
+struct dzindex {                // checkpoints, shared by all cursors
+    pthread_mutex_t lock;
+    struct dzpoint **points;    // ascending out
+    int npoints, maxpoints;
+    int frozen;                 // only the pipeline adds points, in order
+};
+
+struct dzstream {               // a dump read from a pipe, front to back
+    unsigned char *buf;         // file offset boff
+    size_t cap, filled;
+    off_t boff;
+    int eof;
+};
+
+struct dstore {                 // bytes appended to a store
+    unsigned char *mem;         // not yet written, or all of them when not spilled
+    size_t len, cap;
+    off_t size;                 // bytes appended
+    int spilled;                // fd is an unlinked temporary file
+};
+
+/*
+   Parallel inflate of a multi-member gzip'd dump.  The file is cut into
+   regions and the first member that starts in each is found, then the
+   members from one start to the next, a range, are inflated into memory
+   on a thread pool, a few ranges ahead of the reader, and cursors are
+   filled from them, see zp_read.  A range ends exactly where the next one
+   starts, or the guess of a start was wrong and from there on the index
+   is built as the dump is read.
+*/
+struct zrange {
+    off_t start, stop;          // first member, and the start of the next range
+    off_t out;                  // bytes inflated
+    int ok;
+    int done;                   // inflated, for the pipeline
+    unsigned char *mem;         // what was inflated, for the pipeline
+    struct dzindex zi;          // checkpoints, out relative to start
+};
+
+struct zscan {
+    struct dumpfile *df;
+    struct zrange *ranges;
+    int nranges;
+    struct dzpipe *zp;
+};
+
+struct dzpipe {                 // ranges inflated ahead of the reader
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    struct zscan zc;
+    struct tpool *tp;
+    int ahead;                  // ranges inflated past the first one held
+    int posted;                 // ranges handed to the pool
+    int front;                  // first range held
+    off_t fout;                 // dump offset it starts at
+    int merged;                 // ranges checked and their checkpoints in the index
+    off_t mout;                 // dump offset the next one starts at
+    int over;                   // no more ranges are merged, the dump ended or one was bad
+};
+
+struct dzstate {                // one cursor's inflate stream
+    z_stream strm;
+    int live, raw, eof, err;
+    off_t out;                  // dump offset of the next inflated byte
+    off_t stop;                 // do not go on to a member at or past this
+    off_t inend;                // where the last member ended
+    struct dzindex *zi;         // where checkpoints are added
+    unsigned char win[ZWSIZE];  // the last ZWSIZE inflated bytes, circular
+    unsigned int wpos;
+    int wfull;
+    unsigned char *buf;         // bytes at hand for the cursor
+    size_t cap, filled;
+};
+
+static void zp_end(struct dumpfile *df);
+
+static int
+dump_destructor(struct dumpfile *df)
+{
+    int i;
+
+    if (df->zp)
+        zp_end(df);
+    if (df->ss) {
+        free(df->ss->buf);
+        free(df->ss);
+    }
+    if (df->st) {
+        if (!df->st->spilled)
+            df->base = NULL;            // it is mem
+        free(df->st->mem);
+        free(df->st);
+    }
+    if (df->zi) {
+        for (i = 0; i < df->zi->npoints; i++) {
+            free(df->zi->points[i]->window);
+            free(df->zi->points[i]);
+        }
+        free(df->zi->points);
+        pthread_mutex_destroy(&df->zi->lock);
+        free(df->zi);
+    }
+    if (df->base)
+        munmap((void *) df->base, df->msize);
+    if (0 <= df->fd)
+        close(df->fd);
+    return 0;
+}
+
+struct dumpfile *
+dump_open(TALLOC_CTX *memctx, const char *path)
+{
+    struct dumpfile *df;
+    struct stat st;
+    void *base;
+
+    df = talloc_zero(memctx, struct dumpfile);
+    df->fd = -1;
+    df->name = talloc_strdup(df, path);
+    df->span = DUMP_ZSPAN;
+    talloc_set_destructor(df, dump_destructor);
+
+    if (0 == strcmp(path, "-"))
+        df->fd = dup(0);
+    else
+        df->fd = open(path, O_RDONLY);
+    if (0 > df->fd) {
+        fprintf(stderr, "cannot open '%s' for reading, errno %d\n", path, errno);
+        talloc_free(df);
+        return NULL;
+    }
+    if (0 != fstat(df->fd, &st)) {
+        fprintf(stderr, "cannot stat '%s', errno %d\n", path, errno);
+        talloc_free(df);
+        return NULL;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        // a pipe, it can be read only once and only front to back
+        df->ss = (struct dzstream *) calloc(1, sizeof(struct dzstream));
+        df->ss->cap = ZCHUNK;
+        df->ss->buf = (unsigned char *) malloc(ZCHUNK);
+        if (NULL == df->ss->buf) {
+            fprintf(stderr, "cannot allocate a stream buffer for '%s'\n", path);
+            talloc_free(df);
+            return NULL;
+        }
+        df->size = -1;
+        return df;
+    }
+    df->size = df->msize = st.st_size;
+    if (0 == df->size)
+        return df;
+
+    base = mmap(NULL, df->msize, PROT_READ, MAP_PRIVATE, df->fd, 0);
+    if (MAP_FAILED == base) {
+        fprintf(stderr, "cannot map '%s', errno %d\n", path, errno);
+        talloc_free(df);
+        return NULL;
+    }
+    df->base = (const unsigned char *) base;
+
+    // the record scan runs front to back, ask for aggressive read ahead
+    madvise(base, df->msize, MADV_SEQUENTIAL);
+
+    // gzip'd, the size of the dump is known once it has been inflated
+    if (2 <= df->msize && 0x1f == df->base[0] && 0x8b == df->base[1]) {
+        df->zi = (struct dzindex *) calloc(1, sizeof(struct dzindex));
+        pthread_mutex_init(&df->zi->lock, NULL);
+        df->size = -1;
+    }
+    return df;
+}
+
+void
+dump_cursor(struct dumpfile *df, struct dcursor *c, off_t off, off_t len)
+{
+    c->df = df;
+    c->zs = NULL;
+    c->err = 0;
+    c->mark = -1;
+    if (df->zi || df->ss) {
+        c->wend = 0 > len ? OFF_MAX : off + len;
+        if (0 <= df->size && c->wend > df->size)
+            c->wend = df->size;
+        c->buf = c->p = c->end = df->ss ? df->ss->buf : NULL;
+        c->boff = off;
+        return;
+    }
+    if (off > df->size)
+        off = df->size;
+    if (0 > len || len > df->size - off)
+        len = df->size - off;
+    c->buf = df->base;
+    c->boff = 0;
+    c->p = df->base + off;
+    c->end = c->p + len;
+    c->wend = off + len;
+}
+
+void
+dump_memcursor(struct dcursor *c, const unsigned char *mem, off_t off, off_t len)
+{
+    c->df = NULL;
+    c->zs = NULL;
+    c->err = 0;
+    c->mark = -1;
+    c->buf = c->p = mem;
+    c->end = mem + len;
+    c->boff = off;
+    c->wend = off + len;
+}
+
+void
+dump_release(struct dcursor *c)
+{
+    struct dzstate *zs = c->zs;
+
+    if (NULL == zs)
+        return;
+    if (zs->live)
+        inflateEnd(&zs->strm);
+    free(zs->buf);
+    free(zs);
+    c->zs = NULL;
+    c->buf = c->p = c->end = NULL;
+}
+
+void
+dump_short(struct dcursor *c, size_t want)
+{
+    if (!c->err)
+        fprintf(stderr, "dump_short: short read %ld of %zu bytes at 0x%lx\n",
+            (long) (c->end - c->p), want, (long) dump_tell(c));
+    c->err = 1;
+    c->p = c->end;
+}
+
+/* hand inflate the next run of the mapped gzip file */
+static void
+zs_feed(struct dumpfile *df, struct dzstate *zs)
+{
+    off_t left = df->msize - (zs->strm.next_in - df->base);
+
+    zs->strm.avail_in = left > (1 << 30) ? (1 << 30) : (unsigned int) left;
+}
+
+static void
+zi_add(struct dzindex *zi, struct dzpoint *pt)
+{
+    if (zi->npoints == zi->maxpoints) {
+        zi->maxpoints = zi->maxpoints ? 2 * zi->maxpoints : 64;
+        zi->points = (struct dzpoint **) realloc(zi->points, sizeof(struct dzpoint *) * zi->maxpoints);
+        if (NULL == zi->points) {
+            fprintf(stderr, "zi_add: cannot allocate %d checkpoints\n", zi->maxpoints);
+            exit(1);
+        }
+    }
+    zi->points[zi->npoints++] = pt;
+}
+
+/*
+   Remember where inflate is, if the last checkpoint is span bytes back.
+   member is the offset of the gzip member about to start, or -1 when
+   inflate is at a deflate block boundary inside a member.
+*/
+static void
+zs_point(struct dumpfile *df, struct dzstate *zs, off_t member)
+{
+    struct dzindex *zi = zs->zi;
+    struct dzpoint *pt;
+    unsigned int n;
+
+    pthread_mutex_lock(&zi->lock);
+    if (zi->frozen) {
+        pthread_mutex_unlock(&zi->lock);
+        return;
+    }
+    if (0 == zi->npoints ? zs->out >= df->span : zs->out >= zi->points[zi->npoints - 1]->out + df->span) {
+        if (NULL == (pt = (struct dzpoint *) calloc(1, sizeof(struct dzpoint)))) {
+            pthread_mutex_unlock(&zi->lock);
+            return;
+        }
+        pt->out = zs->out;
+        if (0 <= member) {
+            pt->in = member;
+            pt->member = 1;
+        } else {
+            pt->in = zs->strm.next_in - df->base;
+            pt->bits = zs->strm.data_type & 7;
+            n = zs->wfull ? ZWSIZE - zs->wpos : 0;
+            pt->wlen = n + zs->wpos;
+            if (NULL == (pt->window = (unsigned char *) malloc(ZWSIZE))) {
+                free(pt);
+                pthread_mutex_unlock(&zi->lock);
+                return;
+            }
+            memcpy(pt->window, zs->win + zs->wpos, n);
+            memcpy(pt->window + n, zs->win, zs->wpos);
+        }
+        zi_add(zi, pt);
+    }
+    pthread_mutex_unlock(&zi->lock);
+}
+
+/* (re)start inflate at a checkpoint, or at the top of the file */
+static int
+zs_start(struct dumpfile *df, struct dzstate *zs, struct dzpoint *pt)
+{
+    int ret;
+
+    if (zs->live)
+        inflateEnd(&zs->strm);
+    memset(&zs->strm, 0, sizeof(z_stream));
+    zs->live = zs->eof = zs->err = 0;
+    zs->wpos = zs->wfull = 0;
+    if (NULL == zs->zi) {
+        zs->zi = df->zi;
+        zs->stop = df->msize;
+    }
+    if (NULL == pt || pt->member) {
+        ret = inflateInit2(&zs->strm, 15 + 16);
+        zs->strm.next_in = (unsigned char *) df->base + (pt ? pt->in : 0);
+        zs->out = pt ? pt->out : 0;
+        zs->raw = 0;
+    } else {
+        ret = inflateInit2(&zs->strm, -15);
+        zs->strm.next_in = (unsigned char *) df->base + pt->in;
+        zs->out = pt->out;
+        zs->raw = 1;
+        if (Z_OK == ret && pt->bits)
+            ret = inflatePrime(&zs->strm, pt->bits, df->base[pt->in - 1] >> (8 - pt->bits));
+        if (Z_OK == ret)
+            ret = inflateSetDictionary(&zs->strm, pt->window, pt->wlen);
+        memcpy(zs->win, pt->window, pt->wlen);
+        zs->wpos = pt->wlen;
+    }
+    if (Z_OK != ret) {
+        fprintf(stderr, "%s: cannot start inflate, zlib error %d\n", df->name, ret);
+        zs->eof = 1;
+        return -1;
+    }
+    zs->live = 1;
+    zs_feed(df, zs);
+    return 0;
+}
+
+/* a gzip member ended, go on with the next one if there is one */
+static void
+zs_member(struct dumpfile *df, struct dzstate *zs)
+{
+    off_t in = zs->strm.next_in - df->base;
+
+    if (zs->raw)
+        in += 8;                // a restarted stream leaves the crc and length
+    if (in < zs->stop && 2 <= df->msize - in && 0x1f == df->base[in] && 0x8b == df->base[in + 1]) {
+        zs_point(df, zs, in);
+        zs->strm.next_in = (unsigned char *) df->base + in;
+        zs_feed(df, zs);
+        inflateReset2(&zs->strm, 15 + 16);
+        zs->raw = 0;
+        return;
+    }
+    zs->eof = 1;
+    zs->inend = in;
+    if (zs->zi == df->zi)
+        df->size = zs->out;
+}
+
+/* inflate up to len bytes into dst, or drop them when dst is NULL */
+static size_t
+zs_inflate(struct dumpfile *df, struct dzstate *zs, unsigned char *dst, size_t len)
+{
+    size_t got = 0;
+    unsigned int room, n;
+    int ret;
+
+    while (got < len && !zs->eof) {
+        if (ZWSIZE == zs->wpos) {
+            zs->wpos = 0;
+            zs->wfull = 1;
+        }
+        room = ZWSIZE - zs->wpos;
+        if (room > len - got)
+            room = len - got;
+        if (0 == zs->strm.avail_in)
+            zs_feed(df, zs);
+        if (0 == zs->strm.avail_in) {
+            zs->eof = zs->err = 1;
+            if (zs->zi == df->zi) {
+                fprintf(stderr, "%s: compressed data ends at dump offset 0x%lx\n", df->name, (long) zs->out);
+                df->size = zs->out;     // read what there is
+            }
+            break;
+        }
+        zs->strm.next_out = zs->win + zs->wpos;
+        zs->strm.avail_out = room;
+        ret = inflate(&zs->strm, Z_BLOCK);
+        n = room - zs->strm.avail_out;
+        if (dst)
+            memcpy(dst + got, zs->win + zs->wpos, n);
+        zs->wpos += n;
+        zs->out += n;
+        got += n;
+        if (Z_STREAM_END == ret)
+            zs_member(df, zs);
+        else if (Z_OK != ret && Z_BUF_ERROR != ret) {
+            zs->eof = zs->err = 1;
+            if (zs->zi == df->zi) {
+                fprintf(stderr, "%s: inflate error %d at dump offset 0x%lx\n", df->name, ret, (long) zs->out);
+                df->size = zs->out;
+            }
+        } else if ((zs->strm.data_type & 128) && !(zs->strm.data_type & 64))
+            zs_point(df, zs, -1);
+    }
+    return got;
+}
+
+/* get the stream to dump offset off, from a checkpoint if that is closer */
+static void
+zs_position(struct dumpfile *df, struct dzstate *zs, off_t off)
+{
+    struct dzindex *zi = df->zi;
+    struct dzpoint *pt = NULL;
+    int lo, hi, mid;
+
+    pthread_mutex_lock(&zi->lock);
+    lo = 0;
+    hi = zi->npoints - 1;
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        if (zi->points[mid]->out <= off) {
+            pt = zi->points[mid];
+            lo = mid + 1;
+        } else
+            hi = mid - 1;
+    }
+    pthread_mutex_unlock(&zi->lock);
+
+    if (!zs->live || off < zs->out || (pt && pt->out > zs->out) || (zs->eof && off > zs->out))
+        zs_start(df, zs, pt);
+    while (zs->out < off && !zs->eof)
+        zs_inflate(df, zs, NULL, off - zs->out);
+}
+
+/*
+   The pipeline.  Ranges are handed to the pool a few ahead of the first
+   one held, and are checked and merged into the index in order as they
+   are done: a range is good when it ended where the next one starts.
+   From the first bad one on, or once all are merged, no points are
+   added here, and cursors inflate for themselves past what is held.
+   Called with zp->lock held.
+*/
+static void
+zp_post(struct dzpipe *zp, int upto)
+{
+    if (upto < zp->front + zp->ahead)
+        upto = zp->front + zp->ahead;
+    if (upto > zp->zc.nranges)
+        upto = zp->zc.nranges;
+    if (upto > zp->posted) {
+        zp->posted = upto;
+        tpool_post(zp->tp, upto);
+    }
+}
+
+static void
+zp_merge(struct dumpfile *df)
+{
+    struct dzpipe *zp = df->zp;
+    struct zrange *zr;
+    int i;
+
+    while (!zp->over && zp->merged < zp->zc.nranges && (zr = zp->zc.ranges + zp->merged)->done) {
+        if (!zr->ok) {
+            fprintf(stderr, "%s: gzip members could not be inflated in parallel past dump offset 0x%lx\n",
+                df->name, (long) zp->mout);
+            zp->over = 1;
+            break;
+        }
+        pthread_mutex_lock(&df->zi->lock);
+        for (i = 0; i < zr->zi.npoints; i++) {
+            zr->zi.points[i]->out += zp->mout;
+            zi_add(df->zi, zr->zi.points[i]);
+        }
+        pthread_mutex_unlock(&df->zi->lock);
+        free(zr->zi.points);
+        zr->zi.points = NULL;
+        zr->zi.npoints = 0;
+        zp->mout += zr->out;
+        zp->merged++;
+    }
+    if (zp->merged == zp->zc.nranges && !zp->over) {
+        df->size = zp->mout;
+        zp->over = 1;
+    }
+    if (zp->over) {
+        pthread_mutex_lock(&df->zi->lock);
+        df->zi->frozen = 0;
+        pthread_mutex_unlock(&df->zi->lock);
+    }
+}
+
+/* drop the ranges that end at or before keep, and have more inflated */
+static void
+zp_release(struct dumpfile *df, off_t keep)
+{
+    struct dzpipe *zp = df->zp;
+    struct zrange *zr;
+
+    pthread_mutex_lock(&zp->lock);
+    while (zp->front < zp->merged && zp->fout + (zr = zp->zc.ranges + zp->front)->out <= keep) {
+        free(zr->mem);
+        zr->mem = NULL;
+        zp->fout += zr->out;
+        zp->front++;
+    }
+    zp_post(zp, 0);
+    pthread_mutex_unlock(&zp->lock);
+}
+
+/*
+   Copy the dump from off on into dst from the ranges held, waiting for
+   them to be inflated until min bytes are copied, and going on up to max
+   with what is at hand.  Returns the bytes copied, which is short of min
+   when off is behind what is held or past where the pipeline ended.
+*/
+static size_t
+zp_read(struct dumpfile *df, off_t off, unsigned char *dst, size_t min, size_t max)
+{
+    struct dzpipe *zp = df->zp;
+    struct zrange *zr;
+    size_t got = 0, n;
+    off_t base;
+    int k;
+
+    pthread_mutex_lock(&zp->lock);
+    while (got < max) {
+        for (k = zp->front, base = zp->fout; k < zp->merged && base + zp->zc.ranges[k].out <= off + (off_t) got; k++)
+            base += zp->zc.ranges[k].out;
+        if (off + (off_t) got < base)
+            break;
+        if (k < zp->merged) {
+            zr = zp->zc.ranges + k;
+            n = base + zr->out - (off + got);
+            if (n > max - got)
+                n = max - got;
+            memcpy(dst + got, zr->mem + (off + got - base), n);
+            got += n;
+            continue;
+        }
+        zp_merge(df);
+        if (k < zp->merged)
+            continue;
+        if (zp->over || got >= min)
+            break;
+        zp_post(zp, k + 1);
+        pthread_cond_wait(&zp->done, &zp->lock);
+    }
+    pthread_mutex_unlock(&zp->lock);
+    return got;
+}
+
+/* the first byte dump_fill() has to keep at hand, the mark if there is one */
+static off_t
+dump_keep(struct dcursor *c, off_t pos)
+{
+    return 0 <= c->mark && c->mark < pos && c->mark >= c->boff ? c->mark : pos;
+}
+
+static int
+zs_fill(struct dcursor *c, size_t want)
+{
+    struct dzstate *zs;
+    off_t pos = dump_tell(c), keep = dump_keep(c, pos);
+    size_t have, need;
+
+    if (NULL == (zs = c->zs)) {
+        if (NULL == (zs = c->zs = (struct dzstate *) calloc(1, sizeof(struct dzstate))))
+            return 0;
+    }
+
+    // what is at hand from keep on stays
+    if (keep >= c->boff && keep <= c->boff + (off_t) zs->filled) {
+        have = c->boff + zs->filled - keep;
+        if (keep > c->boff)
+            memmove(zs->buf, zs->buf + (keep - c->boff), have);
+    } else {
+        keep = pos;
+        have = 0;
+    }
+    need = pos - keep + want;
+    if (zs->cap < need) {
+        // grow by doubling, a mark can hold on to a lot
+        zs->cap = zs->cap ? 2 * zs->cap : ZCHUNK;
+        if (zs->cap < need)
+            zs->cap = need;
+        if (NULL == (zs->buf = (unsigned char *) realloc(zs->buf, zs->cap))) {
+            fprintf(stderr, "dump_fill: cannot allocate %zu bytes\n", zs->cap);
+            exit(1);
+        }
+    }
+    if (c->df->zp) {
+        zp_release(c->df, keep);
+        have += zp_read(c->df, keep + have, zs->buf + have, need > have ? need - have : 0, zs->cap - have);
+    }
+    if (have < need) {
+        if (!zs->live || zs->out != keep + (off_t) have)
+            zs_position(c->df, zs, keep + have);
+        have += zs_inflate(c->df, zs, zs->buf + have, zs->cap - have);
+    }
+    zs->filled = have;
+    if (0 <= c->df->size && c->wend > c->df->size)
+        c->wend = c->df->size;  // the dump may just have ended short
+
+    c->buf = zs->buf;
+    c->boff = keep;
+    c->p = c->buf + (pos - keep);
+    c->end = c->buf + (c->wend - keep < (off_t) zs->filled ? c->wend - keep : (off_t) zs->filled);
+    return (size_t) (c->end - c->p) >= want;
+}
+
+/* read from the stream until the buffer holds n bytes, or the stream ends */
+static void
+ss_read(struct dumpfile *df, size_t n)
+{
+    struct dzstream *ss = df->ss;
+    ssize_t got;
+
+    while (ss->filled < n && !ss->eof) {
+        got = read(df->fd, ss->buf + ss->filled, ss->cap - ss->filled);
+        if (0 < got)
+            ss->filled += got;
+        else if (0 > got && EINTR == errno)
+            continue;
+        else {
+            if (0 > got)
+                fprintf(stderr, "%s: read error, errno %d\n", df->name, errno);
+            ss->eof = 1;
+            df->size = ss->boff + ss->filled;
+        }
+    }
+}
+
+static int
+ss_fill(struct dcursor *c, size_t want)
+{
+    struct dumpfile *df = c->df;
+    struct dzstream *ss = df->ss;
+    off_t pos = dump_tell(c), keep = dump_keep(c, pos);
+    size_t need;
+
+    if (keep < ss->boff) {
+        fprintf(stderr, "%s: cannot go back to 0x%lx in a stream\n", df->name, (long) keep);
+        return 0;
+    }
+    // drop what is before keep, reading through it if it has not come in yet
+    while (keep > ss->boff + (off_t) ss->filled && !ss->eof) {
+        ss->boff += ss->filled;
+        ss->filled = 0;
+        ss_read(df, keep - ss->boff < (off_t) ss->cap ? (size_t) (keep - ss->boff) : (size_t) ss->cap);
+    }
+    if (keep > ss->boff + (off_t) ss->filled)
+        keep = ss->boff + ss->filled;
+    memmove(ss->buf, ss->buf + (keep - ss->boff), ss->filled - (keep - ss->boff));
+    ss->filled -= keep - ss->boff;
+    ss->boff = keep;
+
+    need = pos - keep + want;
+    if (ss->cap < need) {
+        ss->cap = need;
+        if (NULL == (ss->buf = (unsigned char *) realloc(ss->buf, ss->cap))) {
+            fprintf(stderr, "dump_fill: cannot allocate %zu bytes\n", ss->cap);
+            exit(1);
+        }
+    }
+    ss_read(df, need);
+
+    c->buf = ss->buf;
+    c->boff = ss->boff;
+    c->p = c->buf + (pos - keep);
+    c->end = c->buf + (c->wend - keep < (off_t) ss->filled ? c->wend - keep : (off_t) ss->filled);
+    if (c->p > c->end)
+        c->p = c->end;
+    return (size_t) (c->end - c->p) >= want;
+}
+
+int
+dump_fill(struct dcursor *c, size_t want)
+{
+    if (NULL == c->df || (NULL == c->df->zi && NULL == c->df->ss))
+        return 0;                       // the mapping or memory is all there is
+    if (0 <= c->df->size && c->wend > c->df->size)
+        c->wend = c->df->size;
+    if ((off_t) want > c->wend - dump_tell(c))
+        return 0;
+    return c->df->zi ? zs_fill(c, want) : ss_fill(c, want);
+}
+
+void
+dump_reseek(struct dcursor *c, off_t off)
+{
+    off_t n;
+
+    if (off > c->wend)
+        off = c->wend;
+    if (c->df && c->df->ss) {
+        struct dzstream *ss = c->df->ss;
+
+        c->buf = ss->buf;
+        if (off >= ss->boff && off <= ss->boff + (off_t) ss->filled) {
+            c->boff = ss->boff;
+            c->p = c->buf + (off - c->boff);
+            c->end = c->buf + (c->wend - c->boff < (off_t) ss->filled ? c->wend - c->boff : (off_t) ss->filled);
+            if (c->p > c->end)
+                c->p = c->end;
+            return;
+        }
+        // nothing at hand, the next dump_fill() reads up to off
+        c->boff = off;
+        c->p = c->end = c->buf;
+        return;
+    }
+    if (NULL == c->df || NULL == c->df->zi) {
+        if (off < c->boff)
+            c->p = c->buf;
+        else if (off > c->boff + (c->end - c->buf))
+            c->p = c->end;
+        else
+            c->p = c->buf + (off - c->boff);
+        return;
+    }
+    // drop what is at hand, the next dump_fill() moves the stream
+    if (c->zs) {
+        if (off >= c->boff && off <= c->boff + (off_t) c->zs->filled) {
+            c->p = c->buf + (off - c->boff);
+            c->end = c->buf + (c->wend - c->boff < (off_t) c->zs->filled ? c->wend - c->boff : (off_t) c->zs->filled);
+            if (c->p > c->end)
+                c->p = c->end;
+            return;
+        }
+        if (0 <= c->mark && c->mark >= c->boff && off > dump_tell(c)) {
+            // stepping over bytes a mark keeps, bring them in
+            c->p = c->end;
+            n = off - dump_tell(c);
+            if (dump_fill(c, n))
+                c->p += n;
+            return;
+        }
+        c->zs->filled = 0;
+    }
+    c->boff = off;
+    c->p = c->end = c->buf;
+}
+
+/* does a gzip member that inflates start at off */
+static int
+zs_probe(struct dumpfile *df, off_t off)
+{
+    unsigned char out[16384];
+    z_stream strm;
+    size_t total = 0;
+    int ret;
+
+    if (18 > df->msize - off || 0x8b != df->base[off + 1] || 8 != df->base[off + 2] || (df->base[off + 3] & 0xe0))
+        return 0;
+    memset(&strm, 0, sizeof(z_stream));
+    if (Z_OK != inflateInit2(&strm, 15 + 16))
+        return 0;
+    strm.next_in = (unsigned char *) df->base + off;
+    strm.avail_in = df->msize - off > (1 << 30) ? (1 << 30) : (unsigned int) (df->msize - off);
+    do {
+        strm.next_out = out;
+        strm.avail_out = sizeof(out);
+        ret = inflate(&strm, Z_NO_FLUSH);
+        total += sizeof(out) - strm.avail_out;
+    } while (Z_OK == ret && total < (1 << 18));
+    inflateEnd(&strm);
+    return Z_OK == ret || Z_STREAM_END == ret;
+}
+
+static void
+zscan_find(void *arg, int job)
+{
+    struct zscan *zc = (struct zscan *) arg;
+    struct dumpfile *df = zc->df;
+    off_t lo = df->msize / zc->nranges * job;
+    off_t hi = job + 1 == zc->nranges ? df->msize : df->msize / zc->nranges * (job + 1);
+    const unsigned char *p;
+
+    zc->ranges[job].start = -1;
+    if (0 == job) {
+        zc->ranges[job].start = 0;
+        return;
+    }
+    for (p = df->base + lo; p < df->base + hi; p++) {
+        if (NULL == (p = (const unsigned char *) memchr(p, 0x1f, df->base + hi - p)))
+            break;
+        if (zs_probe(df, p - df->base)) {
+            zc->ranges[job].start = p - df->base;
+            break;
+        }
+    }
+}
+
+static void
+zscan_inflate(void *arg, int job)
+{
+    struct zscan *zc = (struct zscan *) arg;
+    struct dumpfile *df = zc->df;
+    struct zrange *zr = zc->ranges + job;
+    struct dzstate *zs;
+    struct dzpoint *pt;
+    unsigned char *mem;
+    size_t cap = 0;
+
+    zs = (struct dzstate *) calloc(1, sizeof(struct dzstate));
+    pt = (struct dzpoint *) calloc(1, sizeof(struct dzpoint));
+    if (NULL == zs || NULL == pt) {
+        free(pt);
+        pt = NULL;
+    } else {
+        pt->in = zr->start;
+        pt->member = 1;
+        zi_add(&zr->zi, pt);
+        zs->zi = &zr->zi;
+        zs->stop = zr->stop;
+    }
+    if (pt && 0 == zs_start(df, zs, pt)) {
+        while (!zs->eof) {
+            if ((size_t) zs->out == cap) {
+                cap = cap ? 2 * cap : 4 * (size_t) (zr->stop - zr->start);
+                if (NULL == (mem = (unsigned char *) realloc(zr->mem, cap))) {
+                    zs->err = 1;
+                    break;
+                }
+                zr->mem = mem;
+            }
+            zs_inflate(df, zs, zr->mem + zs->out, cap - zs->out);
+        }
+        zr->ok = !zs->err && (zs->inend == zr->stop || job + 1 == zc->nranges);
+        zr->out = zs->out;
+        inflateEnd(&zs->strm);
+    }
+    free(zs);
+
+    pthread_mutex_lock(&zc->zp->lock);
+    zr->done = 1;
+    pthread_cond_broadcast(&zc->zp->done);
+    pthread_mutex_unlock(&zc->zp->lock);
+}
+
+void
+dump_index(struct dumpfile *df, int nthreads)
+{
+    struct zscan zc;
+    struct dzpipe *zp;
+    off_t most = 0;
+    int i, j, n;
+
+    if (NULL == df->zi || 0 < df->zi->npoints || 2 > nthreads)
+        return;
+    n = df->msize / ZREGION;
+    if (n < 4 * nthreads)
+        n = 4 * nthreads;
+    if (n > df->msize / (1 << 20))
+        n = df->msize / (1 << 20);
+    if (2 > n)
+        return;
+
+    zc.df = df;
+    zc.nranges = n;
+    zc.ranges = (struct zrange *) calloc(n, sizeof(struct zrange));
+    zc.zp = NULL;
+    tpool_run(nthreads, n, zscan_find, &zc);
+
+    // keep the ranges a member was found in, each runs to the next
+    for (i = j = 0; i < n; i++) {
+        if (0 <= zc.ranges[i].start)
+            zc.ranges[j++].start = zc.ranges[i].start;
+    }
+    zc.nranges = j;
+    for (i = 0; i < zc.nranges; i++) {
+        zc.ranges[i].stop = i + 1 < zc.nranges ? zc.ranges[i + 1].start : df->msize;
+        if (most < zc.ranges[i].stop - zc.ranges[i].start)
+            most = zc.ranges[i].stop - zc.ranges[i].start;
+    }
+    // one member, or members too large to hold inflated, index them while they are read
+    if (2 > zc.nranges || most > ZRANGE) {
+        free(zc.ranges);
+        return;
+    }
+
+    zp = df->zp = (struct dzpipe *) calloc(1, sizeof(struct dzpipe));
+    pthread_mutex_init(&zp->lock, NULL);
+    pthread_cond_init(&zp->done, NULL);
+    for (i = 0; i < zc.nranges; i++)
+        pthread_mutex_init(&zc.ranges[i].zi.lock, NULL);
+    zp->zc = zc;
+    zp->zc.zp = zp;
+    zp->ahead = 2 * nthreads;
+    df->zi->frozen = 1;
+    zp->tp = tpool_start(nthreads + 1, zscan_inflate, &zp->zc);
+    pthread_mutex_lock(&zp->lock);
+    zp_post(zp, 0);
+    pthread_mutex_unlock(&zp->lock);
+}
+
+/* stop the pipeline, and drop what it still holds */
+static void
+zp_end(struct dumpfile *df)
+{
+    struct dzpipe *zp = df->zp;
+    struct dzindex *zi;
+    int i, j;
+
+    tpool_finish(zp->tp);
+    for (i = 0; i < zp->zc.nranges; i++) {
+        zi = &zp->zc.ranges[i].zi;
+        for (j = 0; j < zi->npoints; j++) {
+            free(zi->points[j]->window);
+            free(zi->points[j]);
+        }
+        free(zi->points);
+        pthread_mutex_destroy(&zi->lock);
+        free(zp->zc.ranges[i].mem);
+    }
+    free(zp->zc.ranges);
+    pthread_cond_destroy(&zp->done);
+    pthread_mutex_destroy(&zp->lock);
+    free(zp);
+    df->zp = NULL;
+}
+
+struct dumpfile *
+dump_store(TALLOC_CTX *memctx)
+{
+    struct dumpfile *df;
+
+    df = talloc_zero(memctx, struct dumpfile);
+    df->fd = -1;
+    df->name = talloc_strdup(df, "store");
+    df->st = (struct dstore *) calloc(1, sizeof(struct dstore));
+    talloc_set_destructor(df, dump_destructor);
+    return df;
+}
+
+/* move a store that has grown too large for memory to a temporary file */
+static int
+st_spill(struct dumpfile *df)
+{
+    struct dstore *st = df->st;
+    const char *dir = getenv("TMPDIR");
+    char *path;
+
+    path = talloc_asprintf(df, "%s/phatXXXXXX", dir ? dir : "/tmp");
+    if (0 > (df->fd = mkstemp(path))) {
+        fprintf(stderr, "cannot make a spill file in %s, errno %d, keeping it in memory\n", dir ? dir : "/tmp", errno);
+        talloc_free(path);
+        return -1;
+    }
+    unlink(path);
+    talloc_free(path);
+    st->spilled = 1;
+    if (df->base == st->mem)
+        df->base = NULL;
+    return 0;
+}
+
+static void
+st_flush(struct dumpfile *df)
+{
+    struct dstore *st = df->st;
+    size_t done = 0;
+    ssize_t n;
+
+    while (done < st->len) {
+        n = write(df->fd, st->mem + done, st->len - done);
+        if (0 > n && EINTR == errno)
+            continue;
+        if (0 >= n) {
+            fprintf(stderr, "cannot write spill file, errno %d\n", errno);
+            exit(1);
+        }
+        done += n;
+    }
+    st->len = 0;
+}
+
+off_t
+dump_append(struct dumpfile *df, const void *p, size_t n)
+{
+    struct dstore *st = df->st;
+    off_t off = st->size;
+
+    if (!st->spilled && st->len + n > DUMP_SPILL && 0 == st_spill(df))
+        st_flush(df);
+    if (st->spilled && st->len + n > ZCHUNK)
+        st_flush(df);
+    if (st->len + n > st->cap) {
+        st->cap = st->cap ? 2 * st->cap : ZCHUNK;
+        if (st->cap < st->len + n)
+            st->cap = st->len + n;
+        if (NULL == (st->mem = (unsigned char *) realloc(st->mem, st->cap))) {
+            fprintf(stderr, "dump_append: cannot allocate %zu bytes\n", st->cap);
+            exit(1);
+        }
+    }
+    memcpy(st->mem + st->len, p, n);
+    st->len += n;
+    st->size += n;
+    return off;
+}
+
+void
+dump_sync(struct dumpfile *df)
+{
+    struct dstore *st = df->st;
+    void *base;
+
+    if (!st->spilled) {
+        df->base = st->mem;
+        df->size = df->msize = st->size;
+        return;
+    }
+    st_flush(df);
+    if (df->base)
+        munmap((void *) df->base, df->msize);
+    df->base = NULL;
+    df->size = df->msize = st->size;
+    if (0 == st->size)
+        return;
+    base = mmap(NULL, df->msize, PROT_READ, MAP_SHARED, df->fd, 0);
+    if (MAP_FAILED == base) {
+        fprintf(stderr, "cannot map spill file, errno %d\n", errno);
+        exit(1);
+    }
+    df->base = (const unsigned char *) base;
+}
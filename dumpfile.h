@@ -0,0 +1,250 @@
+/*
+   memory mapped access to java hprof dump files
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PHAT_DUMPFILE_H
+#define PHAT_DUMPFILE_H
+#include <sys/types.h>
+#include "talloc.h"
+
+#if defined(__GNUC__)
+#define DUMP_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define DUMP_UNLIKELY(x) (x)
+#endif
+
+#define DUMP_ZSPAN  (16 << 20)  // default spacing of gzip checkpoints
+#define DUMP_SPILL  (1 << 30)   // bytes a store keeps in memory
+
+struct dzindex;
+struct dzstate;
+struct dzstream;
+struct dzpipe;
+struct dstore;
+
+/*
+   A plain dump is used straight from the mapping.  A gzip'd dump is
+   inflated into each cursor's buffer as it is read, and checkpoints of
+   the inflate state are kept every span bytes so a cursor can start
+   anywhere by inflating at most span bytes.  When a dump is made of
+   many gzip members, they are inflated ahead of the reader on a pool of
+   threads and handed to cursors in order, see dump_index().
+   A dump read from a pipe can only be read once, front to back, by a
+   single cursor.  What has to be read again is appended to a store,
+   which is read like a plain dump once it is synced.
+*/
+struct dumpfile {
+    int fd;
+    const char *name;
+    const unsigned char *base;  // mapped image of the whole file
+    off_t msize;                // bytes mapped
+    off_t size;                 // bytes of dump, -1 until a gzip'd dump has been read through
+    off_t span;                 // gzip checkpoint spacing
+    struct dzindex *zi;         // gzip checkpoints, NULL for a plain dump
+    struct dzpipe *zp;          // members being inflated ahead of the reader
+    struct dzstream *ss;        // pipe input
+    struct dstore *st;          // store
+};
+
+/*
+   A cursor is a read position inside a window of the file.  Offsets
+   reported by dump_tell() are file offsets, so they can be stored and
+   later handed back to dump_seek().  The bytes at hand are [buf, end),
+   dump_fill() brings in more when the dump is compressed.
+   Decoding past the end of the window sets err and yields zeros.
+*/
+struct dcursor {
+    const unsigned char *buf;   // file offset boff
+    const unsigned char *p;     // next byte to decode
+    const unsigned char *end;   // end of the bytes at hand
+    off_t boff;
+    off_t wend;                 // file offset of the end of the window
+    off_t mark;                 // dump_fill() keeps the bytes from here at hand, -1 for none
+    int err;
+    struct dumpfile *df;
+    struct dzstate *zs;         // inflate state, gzip'd dumps only
+};
+
+/* map a dump file, the mapping is released when the result is talloc_free()d */
+struct dumpfile *dump_open(TALLOC_CTX *memctx, const char *path);
+
+/* make an empty store */
+struct dumpfile *dump_store(TALLOC_CTX *memctx);
+
+/* append n bytes to a store, returns the offset they can be read at */
+off_t dump_append(struct dumpfile *df, const void *p, size_t n);
+
+/* make what was appended to a store readable, set up cursors again afterwards */
+void dump_sync(struct dumpfile *df);
+
+/* have a multi-member gzip'd dump inflated on nthreads threads, ahead
+   of the reader, building its checkpoints as it goes; other dumps are
+   left as they are */
+void dump_index(struct dumpfile *df, int nthreads);
+
+/* set up a cursor over [off, off + len) of the file, len -1 is to end of file */
+void dump_cursor(struct dumpfile *df, struct dcursor *c, off_t off, off_t len);
+
+/* set up a cursor over len bytes of memory that were copied from file offset off */
+void dump_memcursor(struct dcursor *c, const unsigned char *mem, off_t off, off_t len);
+
+/* release what a cursor holds, it may be set up again afterwards */
+void dump_release(struct dcursor *c);
+
+/* make want bytes at hand, returns 0 if the window or the dump ends first */
+int dump_fill(struct dcursor *c, size_t want);
+
+/* move to a position that is not at hand */
+void dump_reseek(struct dcursor *c, off_t off);
+
+/* report a short read, and park the cursor at the end of its window */
+void dump_short(struct dcursor *c, size_t want);
+
+static inline off_t
+dump_tell(const struct dcursor *c)
+{
+    return c->boff + (c->p - c->buf);
+}
+
+static inline off_t
+dump_left(const struct dcursor *c)
+{
+    return c->wend - dump_tell(c);
+}
+
+/* are there bytes left to read, for windows whose end is not known */
+static inline int
+dump_more(struct dcursor *c)
+{
+    return c->p < c->end || dump_fill(c, 1);
+}
+
+static inline void
+dump_seek(struct dcursor *c, off_t off)
+{
+    if (off >= c->boff && off <= c->boff + (c->end - c->buf))
+        c->p = c->buf + (off - c->boff);
+    else
+        dump_reseek(c, off);
+}
+
+/* keep the bytes from the current position at hand until dump_unmark() */
+static inline void
+dump_mark(struct dcursor *c)
+{
+    c->mark = dump_tell(c);
+}
+
+static inline void
+dump_unmark(struct dcursor *c)
+{
+    c->mark = -1;
+}
+
+static inline int
+dump_need(struct dcursor *c, size_t n)
+{
+    if (DUMP_UNLIKELY((size_t) (c->end - c->p) < n) && !dump_fill(c, n)) {
+        dump_short(c, n);
+        return 0;
+    }
+    return 1;
+}
+
+static inline void
+dump_skip(struct dcursor *c, off_t n)
+{
+    if (DUMP_UNLIKELY(c->end - c->p < n)) {
+        if (n > dump_left(c))
+            dump_short(c, n);
+        else
+            dump_reseek(c, dump_tell(c) + n);
+    } else
+        c->p += n;
+}
+
+/* return a pointer to the next n bytes and step over them,
+   it stays valid until the cursor is next moved */
+static inline const unsigned char *
+dump_bytes(struct dcursor *c, size_t n)
+{
+    const unsigned char *p;
+
+    if (!dump_need(c, n))
+        return NULL;
+    p = c->p;
+    c->p += n;
+    return p;
+}
+
+/* big endian decoders */
+static inline unsigned short
+dump_be16(const unsigned char *p)
+{
+    return (unsigned short) (p[0] << 8 | p[1]);
+}
+
+static inline unsigned int
+dump_be32(const unsigned char *p)
+{
+    return (unsigned int) p[0] << 24 | (unsigned int) p[1] << 16 | (unsigned int) p[2] << 8 | p[3];
+}
+
+static inline unsigned long long
+dump_be64(const unsigned char *p)
+{
+    return (unsigned long long) dump_be32(p) << 32 | dump_be32(p + 4);
+}
+
+static inline unsigned char
+dump_u1(struct dcursor *c)
+{
+    if (DUMP_UNLIKELY(c->p >= c->end) && !dump_need(c, 1))
+        return 0;
+    return *c->p++;
+}
+
+static inline unsigned short
+dump_u2(struct dcursor *c)
+{
+    const unsigned char *p = dump_bytes(c, 2);
+    return p ? dump_be16(p) : 0;
+}
+
+static inline unsigned int
+dump_u4(struct dcursor *c)
+{
+    const unsigned char *p = dump_bytes(c, 4);
+    return p ? dump_be32(p) : 0;
+}
+
+static inline unsigned long long
+dump_u8(struct dcursor *c)
+{
+    const unsigned char *p = dump_bytes(c, 8);
+    return p ? dump_be64(p) : 0;
+}
+
+static inline long long
+dump_ident(struct dcursor *c, unsigned int identsz)
+{
+    if (4 == identsz)
+        return (long long) dump_u4(c);
+    return (long long) dump_u8(c);
+}
+
+#endif /* PHAT_DUMPFILE_H */
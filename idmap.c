@@ -0,0 +1,178 @@
+/*
+   open addressing hash map keyed by 64 bit hprof identifiers
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "idmap.h"
+
+#define IDMAP_MIN_SLOTS 64
+
+/*
+   identifiers are object addresses, so the low bits carry little;
+   fibonacci hashing takes the slot from the high bits of the product
+*/
+static inline size_t
+idmap_hash(const struct idmap *map, uint64_t key)
+{
+    return (size_t) ((key * 0x9e3779b97f4a7c15ULL) >> map->shift);
+}
+
+static void
+idmap_alloc(struct idmap *map, size_t nslots)
+{
+    int bits = 0;
+
+    while (((size_t) 1 << bits) < nslots)
+        bits++;
+    map->slots = talloc_zero_array(map, struct idmap_slot, (size_t) 1 << bits);
+    if (NULL == map->slots) {
+        fprintf(stderr, "idmap: cannot allocate %zu slots\n", (size_t) 1 << bits);
+        exit(1);
+    }
+    map->mask = ((size_t) 1 << bits) - 1;
+    map->shift = 64 - bits;
+}
+
+static void
+idmap_grow(struct idmap *map)
+{
+    struct idmap_slot *old = map->slots;
+    size_t i, oslots = map->mask + 1;
+
+    idmap_alloc(map, 2 * oslots);
+    for (i = 0; i < oslots; i++) {
+        size_t h;
+        if (0 == old[i].key)
+            continue;
+        for (h = idmap_hash(map, old[i].key); map->slots[h].key; h = (h + 1) & map->mask)
+            ;
+        map->slots[h] = old[i];
+    }
+    talloc_free(old);
+}
+
+struct idmap *
+idmap_create(TALLOC_CTX *memctx, size_t hint)
+{
+    struct idmap *map = talloc_zero(memctx, struct idmap);
+
+    if (NULL == map) {
+        fprintf(stderr, "Failed to allocate memory for idmap\n");
+        return NULL;
+    }
+    idmap_alloc(map, hint < IDMAP_MIN_SLOTS / 2 ? IDMAP_MIN_SLOTS : 2 * hint);
+    return map;
+}
+
+void *
+idmap_lookup(struct idmap *map, uint64_t key)
+{
+    size_t h;
+
+    if (0 == key)
+        return map->haszero ? map->zero : NULL;
+    for (h = idmap_hash(map, key); map->slots[h].key; h = (h + 1) & map->mask) {
+        if (key == map->slots[h].key)
+            return map->slots[h].data;
+    }
+    return NULL;
+}
+
+void *
+idmap_insert(struct idmap *map, uint64_t key, void *data)
+{
+    size_t h;
+
+    if (0 == key) {
+        void *prev = map->haszero ? map->zero : NULL;
+        if (!map->haszero)
+            map->count++;
+        map->haszero = 1;
+        map->zero = data;
+        return prev;
+    }
+
+    // keep the load under 3/4 so probe runs stay short
+    if (4 * (map->count + 1) > 3 * (map->mask + 1))
+        idmap_grow(map);
+
+    for (h = idmap_hash(map, key); map->slots[h].key; h = (h + 1) & map->mask) {
+        if (key == map->slots[h].key) {
+            void *prev = map->slots[h].data;
+            map->slots[h].data = data;
+            return prev;
+        }
+    }
+    map->slots[h].key = key;
+    map->slots[h].data = data;
+    map->count++;
+    return NULL;
+}
+
+void
+idmap_traverse(struct idmap *map, void (*func)(void *param, void *data), void *param)
+{
+    size_t i;
+
+    if (map->haszero)
+        (*func)(param, map->zero);
+    for (i = 0; i <= map->mask; i++) {
+        if (map->slots[i].key)
+            (*func)(param, map->slots[i].data);
+    }
+}
+
+static int
+idmap_cmp(const void *l, const void *r)
+{
+    uint64_t lk = ((const struct idmap_slot *) l)->key;
+    uint64_t rk = ((const struct idmap_slot *) r)->key;
+
+    return lk < rk ? -1 : lk > rk;
+}
+
+void **
+idmap_sorted(struct idmap *map, TALLOC_CTX *memctx)
+{
+    struct idmap_slot *tmp;
+    void **out;
+    size_t i, n = 0;
+
+    out = talloc_array(memctx, void *, map->count + 1);
+    tmp = (struct idmap_slot *) malloc(sizeof(struct idmap_slot) * (map->count + 1));
+    if (NULL == out || NULL == tmp) {
+        fprintf(stderr, "idmap: cannot allocate %zu entries to sort\n", map->count);
+        exit(1);
+    }
+    if (map->haszero) {
+        tmp[n].key = 0;
+        tmp[n++].data = map->zero;
+    }
+    for (i = 0; i <= map->mask; i++) {
+        if (map->slots[i].key)
+            tmp[n++] = map->slots[i];
+    }
+    qsort(tmp, n, sizeof(struct idmap_slot), idmap_cmp);
+    for (i = 0; i < n; i++)
+        out[i] = tmp[i].data;
+    out[n] = NULL;
+    free(tmp);
+    return out;
+}
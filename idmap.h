@@ -0,0 +1,61 @@
+/*
+   open addressing hash map keyed by 64 bit hprof identifiers
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PHAT_IDMAP_H
+#define PHAT_IDMAP_H
+#include <stdint.h>
+#include <stddef.h>
+#include "talloc.h"
+
+/*
+   Keys and values sit side by side in one slot array and collisions are
+   resolved by linear probing, so a lookup is usually a single cache miss
+   on the slot plus one on the data it points to.  Key 0, the hprof null
+   identifier, marks an empty slot and is kept outside the array.
+*/
+struct idmap_slot {
+    uint64_t key;
+    void *data;
+};
+
+struct idmap {
+    struct idmap_slot *slots;
+    size_t mask;                // slot count - 1, slot count is a power of 2
+    size_t count;               // keys stored, including key 0
+    int shift;                  // 64 - log2(slot count)
+    int haszero;
+    void *zero;                 // data for key 0
+};
+
+/* create a map, hint is the expected number of keys or 0 */
+struct idmap *idmap_create(TALLOC_CTX *memctx, size_t hint);
+
+/* lookup a key and return its data or NULL */
+void *idmap_lookup(struct idmap *map, uint64_t key);
+
+/* insert data for a key.  If the key was present the previous data is
+   returned and replaced, otherwise NULL.  The data is not stolen. */
+void *idmap_insert(struct idmap *map, uint64_t key, void *data);
+
+/* call func(param, data) for every entry, in no particular order */
+void idmap_traverse(struct idmap *map, void (*func)(void *param, void *data), void *param);
+
+/* return the data of every entry sorted by key, map->count long */
+void **idmap_sorted(struct idmap *map, TALLOC_CTX *memctx);
+
+#endif /* PHAT_IDMAP_H */
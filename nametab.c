@@ -0,0 +1,161 @@
+/*
+   open addressing hash table keyed by name
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nametab.h"
+
+#define NAMETAB_MIN_SLOTS 64
+
+// FNV-1a, class names share long prefixes so every byte has to count
+static inline uint64_t
+nametab_hash(const char *key)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    while (*key) {
+        h ^= (unsigned char) *key++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static void
+nametab_alloc(struct nametab *tab, size_t nslots)
+{
+    size_t n = NAMETAB_MIN_SLOTS;
+
+    while (n < nslots)
+        n <<= 1;
+    tab->slots = talloc_zero_array(tab, struct nametab_slot, n);
+    if (NULL == tab->slots) {
+        fprintf(stderr, "nametab: cannot allocate %zu slots\n", n);
+        exit(1);
+    }
+    tab->mask = n - 1;
+}
+
+static void
+nametab_grow(struct nametab *tab)
+{
+    struct nametab_slot *old = tab->slots;
+    size_t i, oslots = tab->mask + 1;
+
+    nametab_alloc(tab, 2 * oslots);
+    for (i = 0; i < oslots; i++) {
+        size_t h;
+        if (NULL == old[i].key)
+            continue;
+        for (h = old[i].hash & tab->mask; tab->slots[h].key; h = (h + 1) & tab->mask)
+            ;
+        tab->slots[h] = old[i];
+    }
+    talloc_free(old);
+}
+
+struct nametab *
+nametab_create(TALLOC_CTX *memctx, size_t hint)
+{
+    struct nametab *tab = talloc_zero(memctx, struct nametab);
+
+    if (NULL == tab) {
+        fprintf(stderr, "Failed to allocate memory for nametab\n");
+        return NULL;
+    }
+    nametab_alloc(tab, 2 * hint);
+    return tab;
+}
+
+void *
+nametab_lookup(struct nametab *tab, const char *key)
+{
+    uint64_t hash = nametab_hash(key);
+    size_t h;
+
+    for (h = hash & tab->mask; tab->slots[h].key; h = (h + 1) & tab->mask) {
+        if (hash == tab->slots[h].hash && 0 == strcmp(key, tab->slots[h].key))
+            return tab->slots[h].data;
+    }
+    return NULL;
+}
+
+void *
+nametab_insert(struct nametab *tab, const char *key, void *data)
+{
+    uint64_t hash = nametab_hash(key);
+    size_t h;
+
+    // keep the load under 3/4 so probe runs stay short
+    if (4 * (tab->count + 1) > 3 * (tab->mask + 1))
+        nametab_grow(tab);
+
+    for (h = hash & tab->mask; tab->slots[h].key; h = (h + 1) & tab->mask) {
+        if (hash == tab->slots[h].hash && 0 == strcmp(key, tab->slots[h].key))
+            return tab->slots[h].data;
+    }
+    tab->slots[h].hash = hash;
+    tab->slots[h].key = key;
+    tab->slots[h].data = data;
+    tab->count++;
+    talloc_free(tab->sorted);
+    tab->sorted = NULL;
+    return NULL;
+}
+
+static int
+nametab_cmp(const void *l, const void *r)
+{
+    return strcmp((*(struct nametab_slot * const *) l)->key, (*(struct nametab_slot * const *) r)->key);
+}
+
+void
+nametab_prefix(struct nametab *tab, const char *prefix,
+    void (*func)(void *param, void *data), void *param)
+{
+    size_t plen = strlen(prefix);
+    size_t i, lo, hi;
+
+    if (NULL == tab->sorted) {
+        size_t n = 0;
+
+        tab->sorted = talloc_array(tab, struct nametab_slot *, tab->count);
+        if (NULL == tab->sorted && tab->count) {
+            fprintf(stderr, "nametab: cannot allocate %zu entries to sort\n", tab->count);
+            exit(1);
+        }
+        for (i = 0; i <= tab->mask; i++) {
+            if (tab->slots[i].key)
+                tab->sorted[n++] = tab->slots + i;
+        }
+        qsort(tab->sorted, n, sizeof(struct nametab_slot *), nametab_cmp);
+    }
+
+    // the names with the prefix are a run starting at the first name >= prefix
+    for (lo = 0, hi = tab->count; lo < hi; ) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (strcmp(tab->sorted[mid]->key, prefix) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (i = lo; i < tab->count && 0 == strncmp(tab->sorted[i]->key, prefix, plen); i++)
+        (*func)(param, tab->sorted[i]->data);
+}
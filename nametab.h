@@ -0,0 +1,58 @@
+/*
+   open addressing hash table keyed by name
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PHAT_NAMETAB_H
+#define PHAT_NAMETAB_H
+#include <stdint.h>
+#include <stddef.h>
+#include "talloc.h"
+
+/*
+   The full 64-bit hash of each name is kept in its slot, so a probe only
+   compares strings when the hashes agree.  Names are compared in full,
+   two names never share an entry.  Names are not copied, they have to
+   live as long as the table.
+*/
+struct nametab_slot {
+    uint64_t hash;
+    const char *key;            // NULL for an empty slot
+    void *data;
+};
+
+struct nametab {
+    struct nametab_slot *slots;
+    size_t mask;                // slot count - 1, slot count is a power of 2
+    size_t count;
+    struct nametab_slot **sorted;   // by name for prefix walks, made on demand
+};
+
+/* create a table, hint is the expected number of names or 0 */
+struct nametab *nametab_create(TALLOC_CTX *memctx, size_t hint);
+
+/* lookup a name and return its data or NULL */
+void *nametab_lookup(struct nametab *tab, const char *key);
+
+/* insert data for a new name and return NULL.  If the name is present
+   its data is returned and left as it is. */
+void *nametab_insert(struct nametab *tab, const char *key, void *data);
+
+/* call func(param, data) for every name that starts with prefix, in name order */
+void nametab_prefix(struct nametab *tab, const char *prefix,
+    void (*func)(void *param, void *data), void *param);
+
+#endif /* PHAT_NAMETAB_H */
@@ -0,0 +1,128 @@
+/*
+   compact table of heap objects, indexed by hprof identifier
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "objtab.h"
+
+static inline size_t
+objtab_hash(const struct objtab *ot, uint64_t ident)
+{
+    return (size_t) ((ident * 0x9e3779b97f4a7c15ULL) >> ot->shift);
+}
+
+struct objtab *
+objtab_create(TALLOC_CTX *memctx)
+{
+    struct objtab *ot = talloc_zero(memctx, struct objtab);
+
+    if (NULL == ot)
+        fprintf(stderr, "Failed to allocate memory for objtab\n");
+    return ot;
+}
+
+uint32_t
+objtab_append(struct objtab *ot, const struct orec *recs, size_t n)
+{
+    uint32_t first = ot->n;
+
+    if (ot->n + n >= OBJ_NONE) {
+        fprintf(stderr, "objtab: more than %u objects\n", OBJ_NONE - 1);
+        exit(1);
+    }
+    // grow by doubling, there is one append per heap part
+    if (ot->n + n > ot->max) {
+        ot->max = ot->n + n > 2 * ot->max ? ot->n + n : 2 * ot->max;
+        ot->recs = talloc_realloc(ot, ot->recs, struct orec, ot->max);
+        if (NULL == ot->recs) {
+            fprintf(stderr, "objtab: cannot allocate %zu records\n", ot->max);
+            exit(1);
+        }
+    }
+    memcpy(ot->recs + ot->n, recs, n * sizeof(struct orec));
+    ot->n += n;
+    return first;
+}
+
+void
+objtab_index(struct objtab *ot)
+{
+    size_t i, nslots;
+    int bits = 4;
+
+    // fill to at most 2/3, a slot is 4 bytes
+    while (((size_t) 1 << bits) < ot->n + ot->n / 2)
+        bits++;
+    nslots = (size_t) 1 << bits;
+
+    talloc_free(ot->slots);
+    ot->slots = talloc_zero_array(ot, uint32_t, nslots);
+    if (NULL == ot->slots) {
+        fprintf(stderr, "objtab: cannot allocate %zu index slots\n", nslots);
+        exit(1);
+    }
+    ot->mask = nslots - 1;
+    ot->shift = 64 - bits;
+
+    for (i = 0; i < ot->n; i++) {
+        uint64_t ident = ot->recs[i].ident;
+        size_t h;
+
+        for (h = objtab_hash(ot, ident); ot->slots[h]; h = (h + 1) & ot->mask) {
+            if (ident == ot->recs[ot->slots[h] - 1].ident)
+                break;
+        }
+        ot->slots[h] = i + 1;   // a repeated identifier keeps the last record
+    }
+}
+
+uint32_t
+objtab_lookup(const struct objtab *ot, uint64_t ident)
+{
+    size_t h;
+    uint32_t s;
+
+    if (NULL == ot->slots)
+        return OBJ_NONE;
+    for (h = objtab_hash(ot, ident); 0 != (s = ot->slots[h]); h = (h + 1) & ot->mask) {
+        if (ident == ot->recs[s - 1].ident)
+            return s - 1;
+    }
+    return OBJ_NONE;
+}
+
+struct objset *
+objset_create(TALLOC_CTX *memctx, size_t n)
+{
+    struct objset *set = talloc(memctx, struct objset);
+
+    if (NULL == set || NULL == (set->bits = talloc_zero_array(set, uint64_t, (n + 63) / 64 + 1))) {
+        fprintf(stderr, "objset: cannot allocate a set of %zu objects\n", n);
+        exit(1);
+    }
+    set->n = n;
+    return set;
+}
+
+void
+objset_clear(struct objset *set)
+{
+    memset(set->bits, 0, sizeof(uint64_t) * ((set->n + 63) / 64 + 1));
+}
@@ -0,0 +1,104 @@
+/*
+   compact table of heap objects, indexed by hprof identifier
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PHAT_OBJTAB_H
+#define PHAT_OBJTAB_H
+#include <stdint.h>
+#include <stddef.h>
+#include "talloc.h"
+
+/*
+   One record per heap object, 24 bytes.  Objects are numbered densely in
+   the order they were added, and the number is what the rest of phat
+   keeps instead of a pointer.
+*/
+struct orec {
+    uint64_t ident;             // hprof object identifier
+    uint64_t fpos : 48;         // file offset of the field or element data
+    uint64_t htype : 16;        // H_INSTANCE, H_VARRAY, H_OARRAY
+    uint32_t cls;               // dense class number
+    uint32_t count;             // array length
+};
+
+#define OBJ_NONE ((uint32_t) -1)
+
+/*
+   The index is a power of 2 array of object number + 1, 0 marks an empty
+   slot.  A lookup costs one miss on the slot and one on the record it
+   names to compare the identifier.
+*/
+struct objtab {
+    struct orec *recs;
+    size_t n, max;
+    uint32_t *slots;
+    size_t mask;
+    int shift;
+};
+
+struct objtab *objtab_create(TALLOC_CTX *memctx);
+
+/* append n records, returns the number of the first one */
+uint32_t objtab_append(struct objtab *ot, const struct orec *recs, size_t n);
+
+/* (re)build the identifier index over all records */
+void objtab_index(struct objtab *ot);
+
+/* return the number of the object with this identifier, or OBJ_NONE */
+uint32_t objtab_lookup(const struct objtab *ot, uint64_t ident);
+
+/*
+   A set of object numbers, one bit per object.  Traversals keep their
+   state in sets of their own, so they can be repeated, or run side by
+   side, over the same objects.
+*/
+struct objset {
+    uint64_t *bits;
+    size_t n;                   // object numbers [0, n) fit
+};
+
+/* make an empty set for n objects */
+struct objset *objset_create(TALLOC_CTX *memctx, size_t n);
+
+/* empty a set */
+void objset_clear(struct objset *set);
+
+static inline int
+objset_test(const struct objset *set, uint32_t num)
+{
+    return (int) (set->bits[num >> 6] >> (num & 63)) & 1;
+}
+
+/* add num, returns 0 if it was in the set already */
+static inline int
+objset_add(struct objset *set, uint32_t num)
+{
+    uint64_t bit = (uint64_t) 1 << (num & 63);
+
+    if (set->bits[num >> 6] & bit)
+        return 0;
+    set->bits[num >> 6] |= bit;
+    return 1;
+}
+
+static inline void
+objset_del(struct objset *set, uint32_t num)
+{
+    set->bits[num >> 6] &= ~((uint64_t) 1 << (num & 63));
+}
+
+#endif /* PHAT_OBJTAB_H */
@@ -19,8 +19,10 @@
 
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <errno.h>
 #if defined(__sun)
 #include <sys/byteorder.h>
@@ -44,6 +46,15 @@
 
 #include "talloc.h"
 #include "rbtree.h"
+#include "idmap.h"
+#include "arena.h"
+#include "nametab.h"
+#include "strpool.h"
+#include "objtab.h"
+#include "refgraph.h"
+#include "domtree.h"
+#include "dumpfile.h"
+#include "tpool.h"
 
 #if !defined(__sun)
 #define _FILE_OFFSET_BITS 64
@@ -51,19 +62,59 @@
 #define MAGIC_HEADER 0x4a415641   // JAVA
 
 struct jdump {          // java dump
-    FILE *fin;
+    struct dumpfile *dump;
+    struct dcursor cur;         // parse position in dump
+    struct dcursor rcur;        // object loads, see loadObj
+    struct dumpfile *store;     // bytes kept from a streamed dump, object loads read them
     int fVersion;
     unsigned int identsz;
-    trbt_tree_t *sbTable,       // string const table
+    struct idmap *sbTable,      // string const table, ident to ustr number + 1
         *cTable,                // class table, by ident
-        *hTable,                // object table
-        *rsbTable,              // revers string table, by name
-        *rcTable,               // reverse class table, by name
+        *hTable,                // resolved objects, by ident
         *scTable,               // class table, by serial
         *roots;                 // root objects
+    struct objtab *objs;        // every heap object
+    struct refgraph *graph;     // references between objects, then classes, see buildGraph
+    struct refgraph *rgraph;    // and the same turned around, the referrers
+    struct domtree *dom;        // dominators of the graph, see buildDominators
+    struct idmap *arcs;         // class graph, by parent << 32 | child class number, see arc_get
+    struct arena *arcHeap;      // the arcs
+    size_t narcs;
+    struct _cinfo **topo;       // the classes, or their cycle, children first, see findCycles
+    unsigned int ntopo, ncycles;
+    struct arena *heap;         // the hobjects in hTable and their values
+    struct strpool *names;      // decoded UTF8 records and made up class names
+    struct ustr *strs;          // UTF8 records, see getString
+    unsigned int nstrs, maxstrs;
+    char *stext;                // UTF8 bytes of a dump that is not mapped
+    size_t ntext, maxtext;
+    struct _cinfo **classes;    // class table, by class number
+    unsigned int nclasses, maxclasses;
+    trbt_tree_t *rsbTable;      // revers string table, by name
+    struct nametab *rcTable;    // reverse class table, by name, see findClass
+    struct _cinfo *parrays[12]; // primitive array classes, by element type
     struct _cinfo *javaLangClass, *javaLangString, *javaLangClassLoader;
     char *fclass;
+    char *referrers;            // object or classes to list the referrers of, see printReferrers
+    char *paths;                // object or classes to find the roots of, see printPaths
+    int npaths;                 // largest instances of the classes to do that for
+    int dominators;             // print the retained sizes
+    int classgraph;             // print the class graph, see mg_assemble
     int plimit;
+    int pbreadth;               // object array elements printInstance looks at, 0 for all
+    unsigned long long pbytes;  // bytes printInstance prints for one object, 0 for no limit
+    int nthreads;               // heap decode threads
+    size_t window;              // objects loaded per resolve sweep
+    struct _hpart **parts;      // heap records waiting to be decoded
+    int nparts, maxparts;
+    struct tpool *feed;         // decodes parts as splitHeap finds them
+    struct _hstats *hst;        // heap record counts
+};
+
+struct ustr {               // UTF8 record, decoded on first use
+    off_t off;                  // in the mapped dump, or in stext
+    unsigned int len;
+    uint32_t str;               // in names, 0 until decoded
 };
 
 struct _arc {
@@ -74,15 +125,13 @@ struct _arc {
 
     int has_placed;
 
-    long count;
+    long count;                         // references along the arc
+    uint64_t bytes;                     // of the objects they reference, once per reference
     long size;                          // size inherited along arc
     long child_size;                    // child-size inherited along arc
 };
 typedef struct _arc Arc;
 
-Arc ** arcs = NULL;
-long arcs_num = 0, arcs_max = 0;
-
 union hvalue {
     long long ident;
     unsigned char b;
@@ -98,11 +147,17 @@ struct _hobject {           // heap object
 #define H_VARRAY   0x02
 #define H_OARRAY   0x03
 #define H_CYCLE    0x04
+#define ARRAY_PRINT 100             // value array elements printed
+#define ARRAY_KEEP  (ARRAY_PRINT + 1)   // and kept from a streamed dump
+#define HEAP_CHUNK  (4 << 20)       // smallest heap part a record is split into, see splitHeap
+#define PATH_TOP    5               // instances of a class printPaths finds the roots of, by default
     int htype;
-    long long instId, classId;
+    long long instId;
+    unsigned int cnum;          // class number, see jf->classes
     long fpos;
-    long xclassId;
-    char resolved, visit;
+    int xclassId;               // element type of a value array
+    uint32_t num;               // object number, see jf->objs
+    char loaded;
     unsigned int count;
     int size;
     unsigned long osize, csize;
@@ -116,32 +171,46 @@ struct _finfo {         // Field Info
     char ftype;         // field type
     char resolved;      // passed through resolver
     int valsz;          // sizeof object
-    off_t offset;       // for resolved objects
 };
 typedef struct _finfo finfo;
 
+#define FK_NONE     0               // field decode kinds, see resolveClassNode
+#define FK_U1       1
+#define FK_U2       2
+#define FK_U4       4
+#define FK_U8       8
+#define FK_REF      16
+
 struct _cinfo {         // Class Info
     long long ident, nident;
+    unsigned int cnum;          // dense class number
     char *name;
     unsigned long count;
     long long superId, loaderId, signerId, domainId;
+    struct _cinfo *super;       // looked up from superId on first use
+    struct _cinfo *nnext;       // next class of the same name, from another loader
     unsigned short cstats, cfields;
     int tfields;
+    unsigned int isize;         // bytes of instance field data, self + super(s)
+    unsigned int vbase;         // value number of the first field of this class
     char resolved;
     hobject *statics;
     finfo *fields;              // this class's fields, self
-    finfo **values;             // this class's value fields, self + super(s)
+    uint32_t *foff;             // decode program, self: offset in this class's field data
+    unsigned char *fkind;       // and FK_ kind, by field number
+    uint32_t *refs;             // value numbers that hold references, self + super(s)
+    uint32_t *roff;             // and their offsets in the instance field data
+    unsigned int nrefs;
                         // map graph values
     int index;
-    unsigned long size, child_size;
+    unsigned long size, child_size;     // bytes of the objects of the class, and below it
+    unsigned long nobjs;                // objects of the class, arrays too
     Arc *parents;       // list of parent arcs
     Arc *children;      // list of child arcs
-    int cyc_num;
-    struct _cinfo *cyc_head, *cyc_next;
+    int cyc_num;                        // the cycle the class is in, 0 for none
+    struct _cinfo *cyc_head, *cyc_next; // the cycle's node, or the class, and the next member
 #define MG_DFN_NAN  0
-#define MG_DFN_BUSY -1
-    int top_order;
-    char print_flag;
+    int top_order;                      // of the component, children first, from 1
 };
 typedef struct _cinfo cinfo;
 
@@ -155,34 +224,120 @@ struct _rinfo {
 #define  ROOT_NATIVE_STACK   0x4
 #define  ROOT_SYSTEM_CLASS   0x5
 #define  ROOT_THREAD_BLOCK   0x6
+#define  ROOT_MONITOR        0x7
+#define  ROOT_THREAD_OBJ     0x8
+#define  ROOT_UNKNOWN        0x9
     char *desc;
 };
 typedef struct _rinfo rinfo;
 
+struct sweep {                      // objects waiting to be loaded
+    uint32_t *pend;
+    size_t head, n, max;
+    struct objset *queued;          // every object ever put on pend
+};
+
+struct pframe {                     // an object printInstance is in the middle of
+    struct _hobject *ho;
+    int indent, pshort, inString;
+    int i;                          // next field or element
+    int last_cnt;                   // object arrays: the run of null or unknown elements
+    unsigned long long last_pid;
+};
+
+struct walk {                       // state of one traversal, by object number
+    struct objset *sized;           // resolveInstance has sized the object
+    struct objset *shown;           // this printInstance has expanded the object
+    uint32_t *expanded;             // and which, to empty shown for the next one
+    size_t nexpanded, maxexpanded;
+    struct _hobject **stack;        // objects resolveInstance is in the middle of
+    uint64_t *next;                 // and the next edge of each
+    size_t max;
+    struct pframe *frames;          // objects printInstance is in the middle of
+    size_t maxframes;
+};
+
+struct render {                     // one printInstance, see rprintf
+    struct jdump *jf;
+    struct walk *w;
+    size_t sp;                      // frames in use
+    unsigned long long bytes;       // printed so far
+    int stop;                       // the byte budget is spent
+};
+
+struct _hstats {            // heap sub-record counts
+    long roott, rootg, rootl, frame, stack, sclass, tblock, monitor, cclass, inst, oarr, parr;
+};
+typedef struct _hstats hstats;
+
+struct hclass {             // copy of a class dump
+    off_t off;
+    off_t len;
+    unsigned char *data;
+};
+
+struct _hpart {             // heap dump record or segment, decoded by one worker
+    off_t off, len;
+    hstats st;
+    struct orec *objs;      // array cls is the element class number or type until merged
+    long nobjs, maxobjs;
+    rinfo *roots;
+    long nroots, maxroots;
+    struct hclass *classes; // class dumps, read at merge
+    long nclasses, maxclasses;
+    unsigned char *data;    // copy of a gzip'd part, until it is decoded
+    char decoded;           // by splitHeap, as it went
+};
+typedef struct _hpart hpart;
+
 long fakeClass = 1000;
 
-int readVersion(FILE *fin);
-int readUint(FILE *fin, unsigned int *input);
-int readUlong(FILE *fin, unsigned long long *input);
+int readVersion(struct dcursor *cur);
 long long readIdent(struct jdump *);
 struct jdump *readDump(char *findclass, int limit, char *dumpfile);
-void readHeap(struct jdump *, unsigned int hsize);
+hpart *addHeap(struct jdump *, off_t off, unsigned int hsize);
+void splitHeap(struct jdump *, struct dcursor *, off_t off, unsigned int hsize);
+void decodePart(struct jdump *, hpart *, struct dcursor *);
+void readHeap(struct jdump *);
 char *hideSpecials(char *);
-unsigned long resolveInstance(struct jdump *jf, hobject *ho);
-unsigned long hashKey(char *key);
+void addString(struct jdump *, long long id, unsigned int len);
+char *getString(struct jdump *, long long id);
+cinfo *getSuperClass(struct jdump *, cinfo *);
+finfo *fieldAt(cinfo *, int, unsigned int *);
+unsigned long resolveInstance(struct jdump *jf, struct walk *w, hobject *ho);
+void loadObj(struct jdump *jf, hobject *ho, struct sweep *sw);
+void sweepAdd(struct jdump *jf, struct sweep *sw, uint32_t num);
+void resolveSweep(struct jdump *jf, struct sweep *sw);
+void buildGraph(struct jdump *jf);
+void printReferrers(struct jdump *jf, const char *what);
+void buildDominators(struct jdump *jf);
+void printDominators(struct jdump *jf);
+void printPaths(struct jdump *jf, const char *what);
+void nameClass(struct jdump *jf, cinfo *ci);
 cinfo * findClass(struct jdump *jf, char *cname);
-void printString(struct jdump *jf, hobject *ho);
+int sigSize(struct jdump *jf, unsigned char sig);
+hobject *getObj(struct jdump *jf, uint32_t num);
+hobject *findObj(struct jdump *jf, long long id);
+void printString(struct jdump *jf, struct walk *w, hobject *ho);
 
-Arc * arc_lookup(struct jdump *jf, cinfo *parent, cinfo *child);
-void arc_add(struct jdump *jf, hobject *parent, hobject *child, long count);
 void mg_assemble(struct jdump *);
 
 int debug = 0;
+int nthreads = 0;
+int window = 0;
+int zspan = 0;
+char *referrers = NULL;
+int breadth = 0;
+unsigned long long outbytes = 0;
+char *paths = NULL;
+int npaths = 0;
+int dominators = 0;
+int classgraph = 0;
 
 extern int optind;
 
 rinfo *
-mkrinfo(trbt_tree_t *tab, long long rid, long long refid, int rtype, char *desc)
+mkrinfo(TALLOC_CTX *tab, long long rid, long long refid, int rtype, char *desc)
 {
     rinfo *ri = (rinfo *) talloc(tab, rinfo);
     ri->ident = rid;
@@ -192,14 +347,23 @@ mkrinfo(trbt_tree_t *tab, long long rid, long long refid, int rtype, char *desc)
     return ri;
 }
 
+/* make a class, give it the next class number and add it to the class table */
 cinfo *
-mkcinfo(trbt_tree_t *tab, long long cid, long long nid, char *name)
+mkcinfo(struct jdump *jf, long long cid, long long nid, char *name)
 {
-    cinfo *ci = (cinfo *) talloc(tab, cinfo);
+    cinfo *ci = (cinfo *) talloc_zero(jf->cTable, cinfo);
     ci->ident = cid;
     ci->nident = nid;
     ci->name = name;
     ci->tfields = ci->resolved = ci->count = 0;
+
+    if (jf->nclasses == jf->maxclasses) {
+        jf->maxclasses = jf->maxclasses ? 2 * jf->maxclasses : 1024;
+        jf->classes = (cinfo **) realloc(jf->classes, sizeof(cinfo *) * jf->maxclasses);
+    }
+    ci->cnum = jf->nclasses;
+    jf->classes[jf->nclasses++] = ci;
+    idmap_insert(jf->cTable, cid, ci);
     return ci;
 }
 
@@ -211,13 +375,32 @@ main(int argc, char **argv)
     char *findclass = NULL;
     struct jdump *df, *bf;
 
-    while (-1 != (opt = getopt(argc, argv, "ab:C:dl:"))) {
+    while (-1 != (opt = getopt(argc, argv, "ab:C:dDe:gj:l:o:p:r:w:z:"))) {
     switch (opt) {
     case 'a': findclass = strdup("*"); break;
     case 'b': baseline = strdup(optarg); break;
     case 'd': debug++; break;
+    case 'D': dominators = 1; break;
     case 'C': findclass = strdup(optarg); break;
+    case 'j': nthreads = atoi(optarg); break;
+    case 'e': breadth = atoi(optarg); break;
+    case 'g': classgraph = 1; break;
     case 'l': limit = atoi(optarg); break;
+    case 'o': outbytes = strtoull(optarg, NULL, 0); break;
+    case 'p': {
+        char *comma;
+
+        // -p what,count
+        paths = strdup(optarg);
+        if (NULL != (comma = strrchr(paths, ',')) && isdigit((unsigned char) comma[1])) {
+            npaths = atoi(comma + 1);
+            *comma = '\0';
+        }
+        break;
+    }
+    case 'r': referrers = strdup(optarg); break;
+    case 'w': window = atoi(optarg); break;
+    case 'z': zspan = atoi(optarg); break;
     default: 
         printf("opt %d\n");
         break;
@@ -236,26 +419,45 @@ struct jdump *
 readDump(char *fclass, int plimit, char *dumpfile) 
 {
     struct jdump *df;
-    int rc;
     unsigned int magic;
     unsigned long long date;
     time_t tdate;
     struct tm *ltime;
-    char rtype;
+    unsigned char rtype;
+    hpart *hp;
 
-    df = (struct jdump *) malloc(sizeof(struct jdump));
+    df = (struct jdump *) calloc(1, sizeof(struct jdump));
 
     df->fclass = fclass;
+    df->referrers = referrers;
+    df->paths = paths;
+    df->npaths = 0 < npaths ? npaths : PATH_TOP;
+    df->dominators = dominators;
+    df->classgraph = classgraph;
     df->plimit = plimit;
+    df->pbreadth = breadth;
+    df->pbytes = outbytes;
+    df->nthreads = 0 < nthreads ? nthreads : tpool_ncpu();
+    df->window = 0 < window ? window : 65536;
+    df->hst = (hstats *) calloc(1, sizeof(hstats));
 
-    if (NULL == (df->fin = fopen(dumpfile, "r"))) {
-        fprintf(stderr, "cannot open '%s' for reading, errno %d\n", dumpfile, errno);
+    if (NULL == (df->dump = dump_open(NULL, dumpfile)))
         exit(1);
-    }
+    if (0 < zspan)
+        df->dump->span = (off_t) zspan << 20;
+    dump_index(df->dump, df->nthreads);
+    dump_cursor(df->dump, &df->cur, 0, -1);
+    if (df->dump->ss) {
+        // a pipe, keep what resolving objects reads as the heap goes by
+        df->store = dump_store(NULL);
+        dump_cursor(df->store, &df->rcur, 0, -1);
+    } else
+        dump_cursor(df->dump, &df->rcur, 0, -1);
 
     // magic number
-    if (rc = readUint(df->fin, &magic)) {
-        fprintf(stderr, "cannot read header from '%s' for reading, errno %d\n", dumpfile, errno);
+    magic = dump_u4(&df->cur);
+    if (df->cur.err) {
+        fprintf(stderr, "cannot read header from '%s'\n", dumpfile);
         exit(2);
     }
 
@@ -265,14 +467,15 @@ readDump(char *fclass, int plimit, char *dumpfile)
     }
 
     // profile version
-    if (-1 == (df->fVersion = readVersion(df->fin))) {
+    if (-1 == (df->fVersion = readVersion(&df->cur))) {
         fprintf(stderr, "unknown version\n");
         exit(3);
     }
 
     // data
-    if (rc = readUint(df->fin, &df->identsz)) {
-        fprintf(stderr, "cannot read ident size from '%s' for reading, errno %d\n", dumpfile, errno);
+    df->identsz = dump_u4(&df->cur);
+    if (df->cur.err) {
+        fprintf(stderr, "cannot read ident size from '%s'\n", dumpfile);
         exit(2);
     }
 
@@ -281,79 +484,76 @@ readDump(char *fclass, int plimit, char *dumpfile)
         exit(4);
     }
 
-    if (rc = readUlong(df->fin, &date)) {
-        fprintf(stderr, "cannot read date from '%s' for reading, errno %d\n", dumpfile, errno);
+    date = dump_u8(&df->cur);
+    if (df->cur.err) {
+        fprintf(stderr, "cannot read date from '%s'\n", dumpfile);
         exit(2);
     }
     tdate = date / 1000;
     ltime = localtime(&tdate);
     printf("Dump file created %s\n\n", ctime(&tdate));
 
-    df->sbTable = trbt_create(NULL, 0);    // table of strings
+    df->sbTable = idmap_create(NULL, 0);   // table of strings
+    df->names = strpool_create(df->sbTable);
+    if (df->dump->zi || df->dump->ss)
+        df->stext = talloc_array(df->sbTable, char, 1);     // no mapping to come back to
     // df->rsbTable = trbt_create(NULL, 0);   // reverse lookup of sbTable
-    df->cTable = trbt_create(NULL, 0);     // table of classes
-    df->rcTable = trbt_create(NULL, 0);    // reverse lookup of cTable
-    df->scTable = trbt_create(NULL, 0);           // table of classes by serial
-    df->hTable = trbt_create(NULL, 0);     // table of heap objs
-    df->roots = trbt_create(NULL, 0);           // table of root ids
-
-    while (EOF != (rtype = getc(df->fin))) {
-        unsigned int rlen, ts, pos;
-
-        pos = ftell(df->fin) - 1;
-
-        if (rc = readUint(df->fin, &ts)) {
-            puts("");
-            fprintf(stderr, "cannot read timestamp from '%s' for reading, errno %d\n", dumpfile, errno);
-            exit(2);
-        }
-
-        if (rc = readUint(df->fin, &rlen)) {
+    df->cTable = idmap_create(NULL, 0);    // table of classes
+    df->rcTable = nametab_create(NULL, 0); // reverse lookup of cTable
+    df->scTable = idmap_create(NULL, 0);          // table of classes by serial
+    df->hTable = idmap_create(NULL, 0);    // table of resolved heap objs
+    df->objs = objtab_create(NULL);        // table of all heap objs
+    df->heap = arena_create(df->hTable, 0);
+    df->roots = idmap_create(NULL, 0);          // table of root ids
+
+    while (dump_more(&df->cur)) {
+        unsigned int rlen, ts;
+        off_t pos, next;
+
+        pos = dump_tell(&df->cur);
+        rtype = dump_u1(&df->cur);
+        ts = dump_u4(&df->cur);
+        rlen = dump_u4(&df->cur);
+        if (df->cur.err) {
             puts("");
-            fprintf(stderr, "cannot read record length type 0x%x from '%s' for reading, errno %d\n", rtype, dumpfile, errno);
+            fprintf(stderr, "cannot read record header type 0x%x from '%s'\n", rtype, dumpfile);
             exit(2);
         }
+        next = dump_tell(&df->cur) + rlen;
 
         if (debug > 2)
-            printf("0x%08x Read record 0x%02x : 0x%08x\t", pos, rtype, rlen);
+            printf("0x%08lx Read record 0x%02x : 0x%08x\t", (long) pos, rtype, rlen);
+
+        // the feed reads the tables the other records add to
+        if (df->feed && 0x1c != rtype && 0x2c != rtype)
+            tpool_wait(df->feed, 0);
 
-        switch ((unsigned char) rtype) {
+        switch (rtype) {
         case 0x01 : { // HPROF_UTF8
-            unsigned long skey = crc32(0, Z_NULL, 0);;
             long long ident = readIdent(df);
-            int  slen = rlen - df->identsz;
-            char *usb = talloc_zero_array(df->sbTable, char, 1 + rlen - df->identsz);
-            rc = fread(usb, 1, slen, df->fin);
-            usb = hideSpecials(usb);
+            addString(df, ident, rlen - df->identsz);
             if (debug)
-            printf("0x%8x %s\n", ident, usb);
-            trbt_insert32(df->sbTable, (long) ident, usb);
+            printf("0x%8llx %s\n", ident, getString(df, ident));
             // trbt_insert32(df->rsbTable, crc32(skey, usb, slen), (void *) ident);
             break;
         }
         case 0x02 : { // HPROF_LOAD_CLASS
-            unsigned long ckey = crc32(0, Z_NULL, 0);
-            long key, nkey;
             cinfo *ci;
             int serial, stackNum;
             long long classId, classNameId;
 
-            readUint(df->fin, &serial);             // serialNumber
+            serial = dump_u4(&df->cur);             // serialNumber
             classId = readIdent(df);  // classId
-            readUint(df->fin, &stackNum);           // stackTraceSerialNumber
+            stackNum = dump_u4(&df->cur);           // stackTraceSerialNumber
             classNameId = readIdent(df); // classNameID
 
             // name = getNameFromID(classNameId);
             // classNameFromObjectID
             // classNameFromSerialNumber 
 
-            key = (long) classId;
-            nkey = (long) classNameId;
-            ci = mkcinfo(df->cTable, classId, classNameId, (char *) trbt_lookup32(df->sbTable, nkey));
-            trbt_insert32(df->cTable, key, ci);
-            trbt_insert32(df->scTable, serial, ci);
-            ckey = crc32(ckey, ci->name, strlen(ci->name));
-            trbt_insert32(df->rcTable, ckey, ci);
+            ci = mkcinfo(df, classId, classNameId, (char *) getString(df, classNameId));
+            idmap_insert(df->scTable, serial, ci);
+            nameClass(df, ci);
             if (debug) {
             if (4 < df->identsz)
                 printf("0x%016lx classId 0x%08x 0x%016lx %s\n", classId, serial, classNameId, ci->name);
@@ -372,20 +572,20 @@ readDump(char *fclass, int plimit, char *dumpfile)
             mName = readIdent(df);              // methodName
             mSig = readIdent(df);               // methodSig
             srcFile = readIdent(df);            // sourceFile
-            readUint(df->fin, &serial);         // classSer
-            readUint(df->fin, &lineno);         // lineNumber
-            SmNam = (char *) trbt_lookup32(df->sbTable, (long) mName);
-            SmSig = (char *) trbt_lookup32(df->sbTable, (long) mSig);
-            SsrcFile = (char *) trbt_lookup32(df->sbTable, (long) srcFile);
-            ci = (cinfo *) trbt_lookup32(df->scTable, (long) serial);
+            serial = dump_u4(&df->cur);         // classSer
+            lineno = dump_u4(&df->cur);         // lineNumber
+            SmNam = getString(df, mName);
+            SmSig = getString(df, mSig);
+            SsrcFile = getString(df, srcFile);
+            ci = (cinfo *) idmap_lookup(df->scTable, serial);
             printf("[%2d] frame %s %s serial 0x%08x %s %s %d\n", id, SmNam, SmSig, serial, ci->name, SsrcFile, lineno);
             }
             break;
         case 0x05 : { // HPROF_TRACE
             int i, serial, threadSeq, frames;
-            readUint(df->fin, &serial);             // serialNumber
-            readUint(df->fin, &threadSeq);
-            readUint(df->fin, &frames);
+            serial = dump_u4(&df->cur);             // serialNumber
+            threadSeq = dump_u4(&df->cur);
+            frames = dump_u4(&df->cur);
             if (1 || debug)
             printf("trace serial %d tseq: %d %d\n", serial, threadSeq, frames);
             for (i = 0; i < frames; i++) {
@@ -398,16 +598,41 @@ readDump(char *fclass, int plimit, char *dumpfile)
         case 0x0c : { // HPROF_HEAP_DUMP
             // printf("heap dump\n");
             if (debug) puts("");
-            readHeap(df, rlen);
+            if (df->store) {
+                hp = addHeap(df, dump_tell(&df->cur), rlen);
+                decodePart(df, hp, &df->cur);
+            } else
+                splitHeap(df, &df->cur, dump_tell(&df->cur), rlen);
+            readHeap(df);
+            break;
+        }
+        case 0x1c : { // HPROF_HEAP_DUMP_SEGMENT
+            // the segments of a dump are decoded side by side, whole,
+            // unless they would have to be inflated again
+            if (debug) puts("");
+            if (df->store) {
+                hp = addHeap(df, dump_tell(&df->cur), rlen);
+                decodePart(df, hp, &df->cur);
+            } else if (df->dump->zi)
+                splitHeap(df, &df->cur, dump_tell(&df->cur), rlen);
+            else
+                addHeap(df, dump_tell(&df->cur), rlen);
+            break;
+        }
+        case 0x2c : { // HPROF_HEAP_DUMP_END
+            if (debug) puts("");
+            readHeap(df);
             break;
         }
         default:
             if (debug) puts("");
-            fseek(df->fin, rlen, SEEK_CUR);
             break;
         }
+        dump_seek(&df->cur, next);
     }
+    readHeap(df);               // segments without a HEAP_DUMP_END
     puts("");
+    return df;
 }
 
 char *
@@ -422,110 +647,130 @@ hideSpecials(char *in)
     return out;
 }
 
-int
-readUshort(FILE *fin, unsigned short *input)
+/*
+   Note where the bytes of a UTF8 record are, the record is only copied
+   when the dump cannot be read back from its mapping.
+*/
+void
+addString(struct jdump *jf, long long id, unsigned int len)
 {
-    unsigned char sb[2];
-    int rc;
-    unsigned short val;
-
-    if (2 != (rc = fread(sb, 1, 2, fin))) {
-        if (0 != rc)
-            fprintf(stderr, "readUint: short read %d of 2 bytes\n", rc);
-        return -1;
+    struct ustr *us;
+
+    if (jf->nstrs == jf->maxstrs) {
+        jf->maxstrs = jf->maxstrs ? 2 * jf->maxstrs : 4096;
+        jf->strs = talloc_realloc(jf->sbTable, jf->strs, struct ustr, jf->maxstrs);
+    }
+    us = jf->strs + jf->nstrs;
+    us->len = len;
+    us->str = 0;
+    if (jf->stext) {
+        const unsigned char *src = dump_bytes(&jf->cur, len);
+
+        if (NULL == src)
+            return;
+        if (jf->ntext + len > jf->maxtext) {
+            while (jf->ntext + len > jf->maxtext)
+                jf->maxtext = jf->maxtext ? 2 * jf->maxtext : 1 << 20;
+            jf->stext = talloc_realloc(jf->sbTable, jf->stext, char, jf->maxtext);
+        }
+        memcpy(jf->stext + jf->ntext, src, len);
+        us->off = jf->ntext;
+        jf->ntext += len;
+    } else {
+        if (len > dump_left(&jf->cur))
+            return;
+        us->off = dump_tell(&jf->cur);
     }
-
-#if __BYTE_ORDER == __BIGENDIAN
-    val = sb[1] << 8 | sb[0];
-#else
-    val = sb[0] << 8 | sb[1];
-#endif
-    *input = val;
-    return 0;
+    idmap_insert(jf->sbTable, id, (void *) (uintptr_t) ++jf->nstrs);
 }
 
-int
-readUint(FILE *fin, unsigned int *input)
+/* the string of a UTF8 record, made printable the first time it is asked for */
+char *
+getString(struct jdump *jf, long long id)
 {
-    unsigned char sb[4];
-    int rc;
-    unsigned int val;
-
-    if (4 != (rc = fread(sb, 1, 4, fin))) {
-        if (0 != rc)
-            fprintf(stderr, "readUint: short read %d of 4 bytes\n", rc);
-        return -1;
-    }
-
-#if __BYTE_ORDER == __BIGENDIAN
-    val = ((sb[3] << 8 | sb[2]) << 8 | sb[1]) << 8 | sb[0];
-#else
-    val = ((sb[0] << 8 | sb[1]) << 8 | sb[2]) << 8 | sb[3];
-#endif
-    *input = val;
-    return 0;
-}
+    uintptr_t n = (uintptr_t) idmap_lookup(jf->sbTable, id);
+    struct ustr *us;
 
-int
-readUlong(FILE *fin, unsigned long long *input)
-{
-    unsigned char sb[8];
-    int rc;
-    unsigned long long val;
+    if (0 == n)
+        return NULL;
+    us = jf->strs + n - 1;
+    if (0 == us->str && us->len) {
+        char *str = strpool_stage(jf->names, us->len);
 
-    if (8 != (rc = fread(sb, 1, 8, fin))) {
-        if (0 != rc)
-            fprintf(stderr, "readUint: short read %d of 8 bytes\n", rc);
-        return -1;
+        memcpy(str, jf->stext ? jf->stext + us->off : (char *) jf->dump->base + us->off, us->len);
+        str[us->len] = '\0';
+        hideSpecials(str);
+        us->str = strpool_commit(jf->names, us->len);
     }
-
-#if __BYTE_ORDER == __BIGENDIAN
-    val = ((sb[3] << 8 | sb[2]) << 8 | sb[1]) << 8 | sb[0];
-    val = (val << 32) + ((sb[3] << 8 | sb[2]) << 8 | sb[1]) << 8 | sb[0];
-#else
-    val = ((sb[0] << 8 | sb[1]) << 8 | sb[2]) << 8 | sb[3];
-    val = (val << 32) + ((sb[4] << 8 | sb[5]) << 8 | sb[6]) << 8 | sb[7];
-#endif
-    *input = val;
-    return 0;
+    return strpool_str(jf->names, us->str);
 }
 
 long long
 readIdent(struct jdump *jf)
 {
-    unsigned long long lval;
-
-    if (4 == jf->identsz) {
-        unsigned int val;
-        readUint(jf->fin, &val);
-        return (long long) val;
-    }
-    readUlong(jf->fin, &lval);
-    return (long long) lval;
+    return dump_ident(&jf->cur, jf->identsz);
 }
 
 hobject *
-makeObj(trbt_tree_t *tab, int ht, long long iid, long long cid)
+makeObj(struct arena *ar, uint32_t num, int ht, long long iid, unsigned int cnum)
 {
-    hobject *ho = (hobject *) talloc(tab, hobject);
+    hobject *ho = (hobject *) arena_alloc(ar, sizeof(hobject));
 
+    ho->num = num;
     ho->htype = ht;
-    ho->classId = cid;
+    ho->cnum = cnum;
     ho->instId = iid;
     ho->fpos = 0;
-    ho->resolved = ho->visit = 0;
-    ho->size = ho->csize = 0;
+    ho->loaded = 0;
+    ho->size = ho->osize = ho->csize = 0;
     ho->xclassId = 0;
+    ho->hvalues = NULL;
+    return ho;
+}
+
+/* materialize object number num, hobjects are kept in hTable once made */
+hobject *
+getObj(struct jdump *jf, uint32_t num)
+{
+    struct orec *rec = jf->objs->recs + num;
+    cinfo *ci = jf->classes[rec->cls];
+    hobject *ho;
+
+    if (NULL != (ho = (hobject *) idmap_lookup(jf->hTable, rec->ident)))
+        return ho;
+    ho = makeObj(jf->heap, num, rec->htype, rec->ident, rec->cls);
+    ho->fpos = rec->fpos;
+    ho->count = rec->count;
+    if (H_VARRAY == rec->htype)
+        ho->size = sigSize(jf, ci->name[1]);
+    else if (H_OARRAY == rec->htype)
+        ho->size = jf->identsz;
+    idmap_insert(jf->hTable, rec->ident, ho);
     return ho;
 }
 
+/* find a heap object by identifier, NULL if it is not in the dump */
+hobject *
+findObj(struct jdump *jf, long long id)
+{
+    hobject *ho;
+    uint32_t num;
+
+    if (NULL != (ho = (hobject *) idmap_lookup(jf->hTable, id)))
+        return ho;
+    if (OBJ_NONE == (num = objtab_lookup(jf->objs, id)))
+        return NULL;
+    return getObj(jf, num);
+}
+
 int
-readVersion(FILE *fin)
+readVersion(struct dcursor *cur)
 {
     char sb[40];
     int ch, len = 0;
 
-    while (EOF != (ch = getc(fin))) {
+    while (0 < dump_left(cur)) {
+        ch = dump_u1(cur);
         sb[len++] = ch;
         if (0 == ch)
             break;
@@ -563,9 +808,9 @@ sigFromType(unsigned char otype)
 }
 
 int
-readValue(struct jdump *jf, hobject *ho)
+readValue(struct jdump *jf, struct dcursor *cur, hobject *ho)
 {
-    ho->htype = getc(jf->fin);
+    ho->htype = dump_u1(cur);
 
     if (1 <= jf->fVersion)
         ho->htype = sigFromType(ho->htype);
@@ -573,11 +818,11 @@ readValue(struct jdump *jf, hobject *ho)
     switch (ho->htype) {
     case '[' :
     case 'L' : {
-        ho->hvalues[0].ident = readIdent(jf);
+        ho->hvalues[0].ident = dump_ident(cur, jf->identsz);
         return jf->identsz;
     }
     case 'Z' : {
-        ho->hvalues[0].b = getc(jf->fin);
+        ho->hvalues[0].b = dump_u1(cur);
         if (0 != ho->hvalues[0].b && 1 != ho->hvalues[0].b) {
             fprintf(stderr, "readValue: illegal bool read 0x%x\n", ho->hvalues[0].b);
             return -1;
@@ -585,33 +830,33 @@ readValue(struct jdump *jf, hobject *ho)
         return 1;
     }
     case 'B' : {
-        ho->hvalues[0].b = getc(jf->fin);
+        ho->hvalues[0].b = dump_u1(cur);
         return 1;
     }
     case 'S' : {
-        readUshort(jf->fin, &(ho->hvalues[0].c));
+        ho->hvalues[0].c = dump_u2(cur);
         return 2;
     }
     case 'C' : {
-        readUshort(jf->fin, &(ho->hvalues[0].c));
+        ho->hvalues[0].c = dump_u2(cur);
         return 2;
     }
     case 'I' : {
-        readUint(jf->fin, &(ho->hvalues[0].i));
+        ho->hvalues[0].i = dump_u4(cur);
         return 4;
     }
     case 'J' : {
-        readUlong(jf->fin, &(ho->hvalues[0].j));
+        ho->hvalues[0].j = dump_u8(cur);
         return 8;
     }
     case 'F' : {                // float
         ho->hvalues[0].f = 0.0;
-        fseek(jf->fin, 4, SEEK_CUR);
+        dump_skip(cur, 4);
         return 4;
     }
     case 'D' : {                // double
         ho->hvalues[0].d = 0.0;
-        fseek(jf->fin, 8, SEEK_CUR);
+        dump_skip(cur, 8);
         return 8;
     }
     default:
@@ -622,7 +867,54 @@ readValue(struct jdump *jf, hobject *ho)
 }
 
 int
-readClass(struct jdump *jf, unsigned int hsize)
+sigSize(struct jdump *jf, unsigned char sig)
+{
+    switch (sig) {
+    case '[' :
+    case 'L' :  return jf->identsz;
+    case 'Z' :
+    case 'B' :  return 1;
+    case 'S' :
+    case 'C' :  return 2;
+    case 'F' :
+    case 'I' :  return 4;
+    case 'D' :
+    case 'J' :  return 8;
+    }
+    return -1;
+}
+
+/* step over a class dump, returns -1 on a value type it does not know */
+int
+skipClass(struct jdump *jf, struct dcursor *cur)
+{
+    unsigned short cpool, cstats, cfields;
+    int i, vsz;
+
+    dump_skip(cur, 7 * jf->identsz + 8);
+    cpool = dump_u2(cur);
+    for (i = 0; i < cpool; i++) {
+        dump_skip(cur, 2);
+        vsz = dump_u1(cur);
+        if (0 > (vsz = sigSize(jf, 1 <= jf->fVersion ? sigFromType(vsz) : vsz)))
+            return -1;
+        dump_skip(cur, vsz);
+    }
+    cstats = dump_u2(cur);
+    for (i = 0; i < cstats; i++) {
+        dump_skip(cur, jf->identsz);
+        vsz = dump_u1(cur);
+        if (0 > (vsz = sigSize(jf, 1 <= jf->fVersion ? sigFromType(vsz) : vsz)))
+            return -1;
+        dump_skip(cur, vsz);
+    }
+    cfields = dump_u2(cur);
+    dump_skip(cur, cfields * (jf->identsz + 1));
+    return 0;
+}
+
+void
+readClass(struct jdump *jf, struct dcursor *cur)
 {
     long long ident, res1, res2;
     unsigned int stackId, instsz;
@@ -630,248 +922,293 @@ readClass(struct jdump *jf, unsigned int hsize)
     cinfo *ci;
     int i;
 
-    ident = readIdent(jf);
-    ci = (cinfo *) trbt_lookup32(jf->cTable, (long) ident);
-
-    readUint(jf->fin, &stackId);
-    ci->superId = readIdent(jf);
-    ci->loaderId = readIdent(jf);
-    ci->signerId = readIdent(jf);
-    ci->domainId = readIdent(jf);
-    res1 = readIdent(jf);
-    res2 = readIdent(jf);
-    readUint(jf->fin, &instsz);
-    hsize -= (7 * jf->identsz) + 8;
-
-    readUshort(jf->fin, &cpool);             // const pool entries
-    hsize -= 2;
+    ident = dump_ident(cur, jf->identsz);
+    if (NULL == (ci = (cinfo *) idmap_lookup(jf->cTable, ident))) {
+        fprintf(stderr, "readClass: class dump 0x%llx was never loaded\n", ident);
+        return;
+    }
+
+    stackId = dump_u4(cur);
+    ci->superId = dump_ident(cur, jf->identsz);
+    ci->loaderId = dump_ident(cur, jf->identsz);
+    ci->signerId = dump_ident(cur, jf->identsz);
+    ci->domainId = dump_ident(cur, jf->identsz);
+    res1 = dump_ident(cur, jf->identsz);
+    res2 = dump_ident(cur, jf->identsz);
+    instsz = dump_u4(cur);
+
+    cpool = dump_u2(cur);             // const pool entries
     for (i = 0; i < cpool; i++) {
         hobject sho;
         union hvalue hv;
         unsigned short entry;
 
         sho.hvalues = &hv;
-        readUshort(jf->fin, &entry);
-        hsize -= 2;
-        hsize -= readValue(jf, &sho);
+        entry = dump_u2(cur);
+        readValue(jf, cur, &sho);
     }
 
-    readUshort(jf->fin, &(ci->cstats));             // statics
-    hsize -= 2;
+    ci->cstats = dump_u2(cur);             // statics
     if (0 < ci->cstats) {
         ci->statics = talloc_array(ci, hobject, ci->cstats);
         for (i = 0; i < ci->cstats; i++) {
-            ci->statics[i].instId = readIdent(jf);
-            ci->statics[i].resolved = 0;
+            ci->statics[i].instId = dump_ident(cur, jf->identsz);
             ci->statics[i].hvalues = talloc(ci, union hvalue);
-            hsize -= jf->identsz;
-            hsize -= 1 + readValue(jf, ci->statics + i);
+            readValue(jf, cur, ci->statics + i);
         }
     }
 
-    readUshort(jf->fin, &(ci->cfields));             // fields
-    hsize -= 2;
+    ci->cfields = dump_u2(cur);             // fields
     if (0 < ci->cfields) {
         ci->fields = talloc_array(ci, finfo, ci->cfields);
         for (i = 0; i < ci->cfields; i++) {
-            ci->fields[i].ident = readIdent(jf);
-            ci->fields[i].ftype = getc(jf->fin);
+            ci->fields[i].ident = dump_ident(cur, jf->identsz);
+            ci->fields[i].ftype = dump_u1(cur);
             ci->fields[i].resolved = 0;
             if (1 <= jf->fVersion)
                 ci->fields[i].ftype = sigFromType(ci->fields[i].ftype);
-            hsize -= 1 + jf->identsz;
         }
     }
     if (debug)
-    printf("0x%x class %4d %4d %4d %s\n", ident, cpool, ci->cstats, ci->cfields, ci->name);
+    printf("0x%llx class %4d %4d %4d %s\n", ident, cpool, ci->cstats, ci->cfields, ci->name);
     // putchar('c');
+}
+
+int
+primSize(long long elemType)
+{
+    switch (elemType) {
+    case  4 /* T_BOOLEAN */:  return 1;
+    case  5 /* T_CHAR */:     return 2;
+    case  6 /* T_FLOAT */:    return 4;
+    case  7 /* T_DOUBLE */:   return 8;
+    case  8 /* T_BYTE */:     return 1;
+    case  9 /* T_SHORT */:    return 2;
+    case 10 /* T_INT */:      return 4;
+    case 11 /* T_LONG */:     return 8;
+    }
+    return 0;
+}
 
-    return hsize;
+struct orec *
+addObj(hpart *hp, int htype, long long ident, off_t fpos)
+{
+    struct orec *rec;
+
+    if (hp->nobjs == hp->maxobjs) {
+        hp->maxobjs = hp->maxobjs ? 2 * hp->maxobjs : 4096;
+        hp->objs = talloc_realloc(hp, hp->objs, struct orec, hp->maxobjs);
+        if (NULL == hp->objs) {
+            fprintf(stderr, "addObj: cannot allocate %ld objects\n", hp->maxobjs);
+            exit(1);
+        }
+    }
+    rec = hp->objs + hp->nobjs++;
+    rec->ident = ident;
+    rec->fpos = fpos;
+    rec->htype = htype;
+    rec->cls = 0;
+    rec->count = 0;
+    return rec;
 }
 
+/* decode an array dump header, the array is indexed by the merge */
 int
-readArray(struct jdump *jf, unsigned hsize, int prim)
+readArray(struct jdump *jf, hpart *hp, struct dcursor *cur, int prim)
 {
     long long ide, elemClassId;
     unsigned int stackId, isz;
-    char primSig = 0x00;
     int elsz;
-    hobject *ho;
+    cinfo *ci = NULL;
+    struct orec *rec;
 
-    ide = readIdent(jf);
-    readUint(jf->fin, &stackId);
-    readUint(jf->fin, &isz);
-    hsize -= 8 + jf->identsz;
+    ide = dump_ident(cur, jf->identsz);
+    stackId = dump_u4(cur);
+    isz = dump_u4(cur);
     if (prim) {
-        elemClassId = getc(jf->fin);
-        hsize -= 1;
+        elemClassId = dump_u1(cur);
         if (debug)
-        printf("0x%x primary array type %2d %s\n", ide, elemClassId, "");
-    } else {
-        elemClassId = readIdent(jf);
-        hsize -= jf->identsz;
-        if (debug) {
-            cinfo *ci = (cinfo *) trbt_lookup32(jf->cTable, elemClassId);
-            printf("0x%x object array type %x %s\n", ide, elemClassId, ci->name);
-        }
-    }
-    if (prim /* || version < 1 */) {
-        switch (elemClassId) {
-        case  4 /* T_BOOLEAN */:  primSig = 'Z';  elsz = 1;  break;
-        case  5 /* T_CHAR */:     primSig = 'C';  elsz = 2;  break;
-        case  6 /* T_FLOAT */:    primSig = 'F';  elsz = 4;  break;
-        case  7 /* T_DOUBLE */:   primSig = 'D';  elsz = 8;  break;
-        case  8 /* T_BYTE */:     primSig = 'B';  elsz = 1;  break;
-        case  9 /* T_SHORT */:    primSig = 'S';  elsz = 2;  break;
-        case 10 /* T_INT */:      primSig = 'I';  elsz = 4;  break;
-        case 11 /* T_LONG */:     primSig = 'J';  elsz = 8;  break;
-        }
-    }
-    if (0x00 != primSig) {
-        cinfo *ci;
-        char *cname = talloc_zero_array(jf->sbTable, char, 3);
-        cname[0] = '['; 
-        cname[1] = primSig;
-
-        if (NULL == (ci = findClass(jf, cname))) {
-            ci = mkcinfo(jf->cTable, fakeClass++, elemClassId, cname);
-            trbt_insert32(jf->sbTable, (long) elemClassId, cname);
-            trbt_insert32(jf->cTable, fakeClass, ci);
-            trbt_insert32(jf->rcTable, hashKey(cname), ci);
-        }
-
-        hsize -= elsz * isz;
-        ho = makeObj(jf->hTable, H_VARRAY, ide, ci->ident);
-        ho->fpos = ftello(jf->fin);
-        ho->size = elsz;
-        ho->count = isz;
-        fseek(jf->fin, elsz * isz, SEEK_CUR);
+        printf("0x%llx primary array type %2d %s\n", ide, (int) elemClassId, "");
+        if (0 == (elsz = primSize(elemClassId))) {
+            fprintf(stderr, "readArray: unknown primitive type %d in 0x%llx\n", (int) elemClassId, ide);
+            return -1;
+        }
     } else {
-        cinfo *ci;
-        char *cname; 
-        ci = (cinfo *) trbt_lookup32(jf->cTable, elemClassId);
-        cname = talloc_zero_array(jf->sbTable, char, 2 + strlen(ci->name));
-        // *cname = '[';
-        strcat(cname, ci->name);
-        if (NULL == (ci = findClass(jf, cname))) {
-            ci = mkcinfo(jf->cTable, fakeClass++, elemClassId, cname);
-            trbt_insert32(jf->sbTable, (long) elemClassId, cname);
-            trbt_insert32(jf->cTable, fakeClass, ci);
-            trbt_insert32(jf->rcTable, hashKey(cname), ci);
-        }
-
-        hsize -= jf->identsz * isz;
-        ho = makeObj(jf->hTable, H_OARRAY, ide, ci->ident);
-        ho->fpos = ftello(jf->fin);
-        ho->size = jf->identsz;
-        ho->count = isz;
-        fseek(jf->fin, jf->identsz * isz, SEEK_CUR);
-    }
-    trbt_insert32(jf->hTable, ide, ho);
-    return hsize;
+        elemClassId = dump_ident(cur, jf->identsz);
+        elsz = jf->identsz;
+        ci = (cinfo *) idmap_lookup(jf->cTable, elemClassId);
+        if (debug)
+            printf("0x%llx object array type %llx %s\n", ide, elemClassId, ci ? ci->name : "unknown");
+    }
+
+    if (prim || ci) {
+        rec = addObj(hp, prim ? H_VARRAY : H_OARRAY, ide, dump_tell(cur));
+        rec->cls = prim ? elemClassId : ci->cnum;
+        rec->count = isz;
+        if (jf->store) {
+            // keep the elements that can be printed, and every reference
+            unsigned int keep = prim && ARRAY_KEEP < isz ? ARRAY_KEEP : isz;
+            const unsigned char *src = dump_bytes(cur, (size_t) elsz * keep);
+            if (src)
+                rec->fpos = dump_append(jf->store, src, (size_t) elsz * keep);
+            isz -= keep;
+        }
+    } else
+        fprintf(stderr, "readArray: array 0x%llx of unknown class 0x%llx\n", ide, elemClassId);
+    dump_skip(cur, (off_t) elsz * isz);
+    return 0;
 }
 
-void
-printClass_r(trbt_node_t *node)
+/* find, or make up, the class of an array decoded by readArray,
+   elem is the primitive type (readArray checked it) or the class number */
+cinfo *
+arrayClass(struct jdump *jf, int htype, unsigned int elem)
 {
+    char cname[3] = "[";
     cinfo *ci;
-    if (NULL == node)
-        return;
-    printClass_r(node->left);
-    ci = (cinfo *) node->data;
-    printf("0x%x class 0x%x %d %s\n", ci->ident, ci->nident, ci->count, ci->name);
-    printClass_r(node->right);
+
+    // object arrays are counted with their element class
+    if (H_OARRAY == htype)
+        return jf->classes[elem];
+    if (NULL != (ci = jf->parrays[elem]))
+        return ci;
+
+    switch (elem) {
+    case  4 /* T_BOOLEAN */:  cname[1] = 'Z';  break;
+    case  5 /* T_CHAR */:     cname[1] = 'C';  break;
+    case  6 /* T_FLOAT */:    cname[1] = 'F';  break;
+    case  7 /* T_DOUBLE */:   cname[1] = 'D';  break;
+    case  8 /* T_BYTE */:     cname[1] = 'B';  break;
+    case  9 /* T_SHORT */:    cname[1] = 'S';  break;
+    case 10 /* T_INT */:      cname[1] = 'I';  break;
+    case 11 /* T_LONG */:     cname[1] = 'J';  break;
+    }
+
+    // the name is only kept when the class has to be made up
+    if (NULL == (ci = findClass(jf, cname))) {
+        ci = mkcinfo(jf, fakeClass++, elem, strpool_str(jf->names, strpool_intern(jf->names, cname, 2)));
+        nameClass(jf, ci);
+    }
+    jf->parrays[elem] = ci;
+    return ci;
 }
 
 void
-printClass(trbt_node_t *node)
-{
-    trbt_node_t **stack = (trbt_node_t **) malloc(sizeof(trbt_node_t *) * 20);
-    int curr = 0, size = 20;
-
-    while (node) {
-        cinfo *ci = (cinfo *) node->data;
-        printf("0x%x instance 0x%x %d %s\n", ci->ident, ci->nident, ci->count, ci->name);
-        if (node->right) {
-            if (curr == size) {
-                stack = (trbt_node_t **) realloc(stack, sizeof(trbt_node_t *) * (size + 20));
-                size += 20;
-            }
-            stack[curr++] = node->right;
-        }
-        if (node->left) {
-            node = node->left;
-            continue;
-        }
-        if (0 < curr)
-            node = stack[--curr];
-        else 
-            node = NULL;
-    }
+printClasses(struct jdump *jf)
+{
+    cinfo **classes = (cinfo **) idmap_sorted(jf->cTable, NULL);
+    cinfo *ci;
+    int i;
+
+    for (i = 0; NULL != (ci = classes[i]); i++)
+        printf("0x%llx class 0x%llx %lu %s\n", ci->ident, ci->nident, ci->count, ci->name);
+    talloc_free(classes);
 }
 
-unsigned long
-hashKey(char *key)
+/* enter a class in rcTable, classes of the same name from other loaders
+   are chained behind the first one */
+void
+nameClass(struct jdump *jf, cinfo *ci)
 {
-    unsigned long ckey = crc32(0, Z_NULL, 0);
-    return crc32(ckey, key, strlen(key));
+    cinfo *first;
+
+    if (NULL == ci->name)
+        return;
+    if (NULL != (first = (cinfo *) nametab_insert(jf->rcTable, ci->name, ci))) {
+        ci->nnext = first->nnext;
+        first->nnext = ci;
+    }
 }
 
+/* the first class loaded by that name, see nnext for the others */
 cinfo *
 findClass(struct jdump *jf, char *cname)
 {
-    return (cinfo *) trbt_lookup32(jf->rcTable, hashKey(cname));
+    return (cinfo *) nametab_lookup(jf->rcTable, cname);
 }
 
+static void
+selectClass(void *param, void *data)
+{
+    char *sel = (char *) param;
+    cinfo *ci;
+
+    for (ci = (cinfo *) data; ci; ci = ci->nnext)
+        sel[ci->cnum] = 1;
+}
+
+/*
+   Mark the classes a -C argument names in a table indexed by class
+   number, from any loader.  A trailing '*' matches every class name
+   with that prefix.  Returns the number of classes marked.
+*/
 int
-resolveSClassSize(struct jdump *jf, cinfo *ci)
+selectClasses(struct jdump *jf, const char *pattern, char *sel)
 {
-    cinfo *super;
+    size_t len = strlen(pattern);
+    unsigned int i;
+    int n = 0;
+    cinfo *ci;
+
+    if (len && '*' == pattern[len - 1]) {
+        char *prefix = talloc_strndup(NULL, pattern, len - 1);
 
-    if (0 == ci->superId)
-        return 0;
+        nametab_prefix(jf->rcTable, prefix, selectClass, sel);
+        talloc_free(prefix);
+    } else if (NULL != (ci = (cinfo *) nametab_lookup(jf->rcTable, pattern)))
+        selectClass(sel, ci);
+    for (i = 0; i < jf->nclasses; i++)
+        n += sel[i];
+    return n;
+}
+
+int
+resolveSClassSize(struct jdump *jf, cinfo *ci)
+{
+    cinfo *super = getSuperClass(jf, ci);
 
-    super = (cinfo *) trbt_lookup32(jf->cTable, ci->superId);
-    return ci->cfields + resolveSClassSize(jf, super);
+    return ci->cfields + (super ? resolveSClassSize(jf, super) : 0);
 }
 
 void
 resolveField(struct jdump *jf, hobject *fi)
 {
-    if (fi->resolved)
-        return;
 #ifdef notdef
-    fi->name = (char *) trbt_lookup32(jf->sbTable, (long) fi->ident);
+    fi->name = getString(jf, fi->ident);
     switch (fi->ftype) {
     case 'L':
     case '[':
     }
 #endif
-    fi->resolved = 1;
 }
 
 cinfo *
 getSuperClass(struct jdump *jf, cinfo *ci)
 {
-    return (cinfo *) trbt_lookup32(jf->cTable, ci->superId);
-}
-
-finfo *
-copyField(cinfo *parent, finfo *src)
-{
-    finfo *dest = (finfo *) talloc(parent, finfo);
-    memcpy(dest, src, sizeof(finfo));
-    return dest;
+    if (NULL == ci->super && 0 != ci->superId)
+        ci->super = (cinfo *) idmap_lookup(jf->cTable, ci->superId);
+    return ci->super;
 }
 
+/*
+   Compile the decode program of a class's own fields.  The field data of
+   an instance holds the fields of its class first, then its superclass's
+   and so on, so the fields of class cc start ci->isize - cc->isize bytes
+   into the data of an instance of any subclass ci.  Their values are
+   numbered in the other order, the top superclass first, from cc->vbase.
+   Nothing of a superclass is copied into its subclasses but the list of
+   value numbers that hold references.
+*/
 void
 resolveClassNode(struct jdump *jf, cinfo *ci)
 {
     cinfo *super;
+    unsigned int off = 0;
     int i;
     if (ci->resolved)
         return;
     ci->tfields = resolveSClassSize(jf, ci);
+    ci->vbase = ci->tfields - ci->cfields;
 
     // loader
     // signers
@@ -883,118 +1220,242 @@ resolveClassNode(struct jdump *jf, cinfo *ci)
     if (0 != (super = getSuperClass(jf, ci)))
         resolveClassNode(jf, super);
 
-    if (0 < ci->tfields) {
-        int target, index, fieldNo;
-        cinfo *cc = ci;
-
-        ci->values = talloc_array(ci, finfo *, ci->tfields);
-        target = ci->tfields - cc->cfields;
-        fieldNo = index = 0;
-        for (i = 0; i < ci->tfields; i++, fieldNo++) {
-            finfo *field, **value;
-            while (fieldNo >= cc->cfields) {
-                cc = getSuperClass(jf, cc);
-                fieldNo = 0;
-                target -= cc->cfields;
+    if (0 < ci->cfields) {
+        ci->foff = talloc_array(ci, uint32_t, ci->cfields);
+        ci->fkind = talloc_array(ci, unsigned char, ci->cfields);
+    }
+    for (i = 0; i < ci->cfields; i++) {
+        finfo *field = ci->fields + i;
+
+        field->name = getString(jf, field->ident);
+        ci->foff[i] = off;
+        switch (field->ftype) {
+        case 'L': 
+        case '[':  ci->fkind[i] = FK_REF; off += jf->identsz;  ci->nrefs++;  break;
+        case 'Z': 
+        case 'B':  ci->fkind[i] = FK_U1;  off += 1; break;
+        case 'S': 
+        case 'C':  ci->fkind[i] = FK_U2;  off += 2; break;
+        case 'F':
+        case 'I':  ci->fkind[i] = FK_U4;  off += 4; break;
+        case 'D':
+        case 'J':  ci->fkind[i] = FK_U8;  off += 8; break;
+        default:   ci->fkind[i] = FK_NONE;  break;
+        }
+    }
+    ci->isize = off + (super ? super->isize : 0);
+
+    // references in value order, the superclass's list then this class's fields
+    if (super)
+        ci->nrefs += super->nrefs;
+    if (0 < ci->nrefs) {
+        unsigned int n = 0;
+
+        ci->refs = talloc_array(ci, uint32_t, ci->nrefs);
+        ci->roff = talloc_array(ci, uint32_t, ci->nrefs);
+        if (super)
+            for (n = 0; n < super->nrefs; n++) {
+                ci->refs[n] = super->refs[n];
+                ci->roff[n] = super->roff[n] + off;
             }
-            value = ci->values + target + fieldNo;
-            if (cc == ci) {
-                field = *value = cc->fields + fieldNo;
-                field->name = (char *) trbt_lookup32(jf->sbTable, (long) field->ident);
-            } else
-                field = *value = copyField(ci, cc->fields + fieldNo);
-
-            field->offset = index;
-            switch (field->ftype) {
-            case 'L': 
-            case '[':  index += jf->identsz;  break;
-            case 'Z': 
-            case 'B':  index += 1; break;
-            case 'S': 
-            case 'C':  index += 2; break;
-            case 'F':
-            case 'I':  index += 4; break;
-            case 'D':
-            case 'J':  index += 8; break;
+        for (i = 0; i < ci->cfields; i++)
+            if (FK_REF == ci->fkind[i]) {
+                ci->roff[n] = ci->foff[i];
+                ci->refs[n++] = ci->vbase + i;
             }
-        }
-        ci->size = index;
     }
     ci->resolved = 1;
 }
 
-void
-resolveClass(struct jdump *jf, trbt_node_t *cnode)
+/* the field of value number i of an instance of ci, off is set to its
+   offset in the instance field data */
+finfo *
+fieldAt(cinfo *ci, int i, unsigned int *off)
 {
-    if (NULL == cnode)
-        return;
-    resolveClass(jf, cnode->left);
-    resolveClassNode(jf, (cinfo *) cnode->data);
-    resolveClass(jf, cnode->right);
+    cinfo *cc = ci;
+
+    while (i < cc->vbase)
+        cc = cc->super;
+    i -= cc->vbase;
+    *off = ci->isize - cc->isize + cc->foff[i];
+    return cc->fields + i;
 }
 
 void
-resolveInstances(struct jdump *jf, trbt_node_t *cnode)
+resolveInstances(struct jdump *jf, struct walk *w)
 {
-    if (NULL == cnode)
-        return;
-    resolveInstances(jf, cnode->left);
-    resolveInstance(jf, (hobject *) cnode->data);
-    resolveInstances(jf, cnode->right);
+    struct sweep sw = { 0 };
+    uint32_t i;
+
+    for (i = 0; i < jf->objs->n; i++)
+        sweepAdd(jf, &sw, i);
+    resolveSweep(jf, &sw);
+    for (i = 0; i < jf->objs->n; i++)
+        resolveInstance(jf, w, getObj(jf, i));
 }
 
 void
-resolveClasses(struct jdump *jf)
+resolveClasses(struct jdump *jf, struct walk *w)
 {
+    unsigned int i;
+
     jf->javaLangClass = findClass(jf, "java/lang/Class");
     jf->javaLangClassLoader = findClass(jf, "java/lang/ClassLoader");
 
-    resolveClass(jf, jf->cTable->root);
-    resolveInstances(jf, jf->hTable->root);
+    for (i = 0; i < jf->nclasses; i++)
+        resolveClassNode(jf, jf->classes[i]);
+    resolveInstances(jf, w);
 }
 
-unsigned long
-resolveInstance(struct jdump *jf, hobject *ho)
+/* set up the state of a traversal over every object */
+void
+walkStart(struct jdump *jf, struct walk *w)
 {
-    cinfo *ci;
+    w->sized = objset_create(NULL, jf->objs->n);
+    w->shown = objset_create(NULL, jf->objs->n);
+    w->stack = NULL;
+    w->next = NULL;
+    w->max = 0;
+    w->frames = NULL;
+    w->maxframes = 0;
+    w->expanded = NULL;
+    w->nexpanded = w->maxexpanded = 0;
+}
+
+void
+walkEnd(struct walk *w)
+{
+    talloc_free(w->sized);
+    talloc_free(w->shown);
+    free(w->stack);
+    free(w->next);
+    free(w->frames);
+    free(w->expanded);
+}
+
+/* queue object number num on the sweep, unless it was queued before */
+void
+sweepAdd(struct jdump *jf, struct sweep *sw, uint32_t num)
+{
+    if (NULL == sw->queued)
+        sw->queued = objset_create(NULL, jf->objs->n);
+    if (!objset_add(sw->queued, num))
+        return;
+    if (sw->n == sw->max) {
+        sw->max = sw->max ? 2 * sw->max : 4096;
+        sw->pend = (uint32_t *) realloc(sw->pend, sizeof(uint32_t) * sw->max);
+        if (NULL == sw->pend) {
+            fprintf(stderr, "sweepAdd: cannot queue %lu objects\n", (unsigned long) sw->max);
+            exit(1);
+        }
+    }
+    sw->pend[sw->n++] = num;
+}
+
+/* queue the object a reference names, if it is in the dump */
+static void
+sweepRef(struct jdump *jf, struct sweep *sw, long long ident)
+{
+    uint32_t num;
+
+    if (sw && ident && OBJ_NONE != (num = objtab_lookup(jf->objs, ident)))
+        sweepAdd(jf, sw, num);
+}
+
+static int
+numCompare(const void *a, const void *b)
+{
+    uint32_t l = *(const uint32_t *) a, r = *(const uint32_t *) b;
+    return l < r ? -1 : l > r;
+}
+
+/*
+   Load every queued object, and everything reachable from them, a window
+   at a time.  Object numbers follow the file, so each window is sorted
+   by number and read front to back; references found while loading are
+   queued for a later window.  resolveInstance then runs from memory.
+*/
+void
+resolveSweep(struct jdump *jf, struct sweep *sw)
+{
+    size_t i, cnt;
+
+    while (sw->head < sw->n) {
+        cnt = sw->n - sw->head;
+        if (cnt > jf->window)
+            cnt = jf->window;
+        qsort(sw->pend + sw->head, cnt, sizeof(uint32_t), numCompare);
+        for (i = sw->head; i < sw->head + cnt; i++)
+            loadObj(jf, getObj(jf, sw->pend[i]), sw);
+        sw->head += cnt;
+        if (sw->head > sw->max / 2) {
+            memmove(sw->pend, sw->pend + sw->head, sizeof(uint32_t) * (sw->n - sw->head));
+            sw->n -= sw->head;
+            sw->head = 0;
+        }
+    }
+    free(sw->pend);
+    talloc_free(sw->queued);
+    memset(sw, 0, sizeof(struct sweep));
+}
+
+/* copy n bytes of array elements, a short dump leaves zeros */
+static void
+copyElements(struct dcursor *cur, void *dst, size_t n)
+{
+    const unsigned char *src = dump_bytes(cur, n);
+
+    if (src)
+        memcpy(dst, src, n);
+}
+
+/*
+   Decode the values of an object from the dump.  References are not
+   followed, they are queued on sw when it is given.
+*/
+void
+loadObj(struct jdump *jf, hobject *ho, struct sweep *sw)
+{
+    cinfo *ci, *cc;
+    struct dcursor *cur = &jf->rcur;
+    const unsigned char *blob;
     unsigned long size = 0;
     int i;
 
-    if (ho->resolved)
-        return ho->osize + ho->csize;
-    ho->resolved = 1;
+    if (ho->loaded)
+        return;
+    ho->loaded = 1;
 
-    ci = (cinfo *) trbt_lookup32(jf->cTable, ho->classId);
+    ci = jf->classes[ho->cnum];
     if (!ci->resolved) 
         resolveClassNode(jf, ci);
 
     if (H_VARRAY == ho->htype) {
-        ho->hvalues = talloc_array(ho, union hvalue, ho->count);
+        // a streamed dump only kept the elements that get printed
+        unsigned int keep = jf->store && ARRAY_KEEP < ho->count ? ARRAY_KEEP : ho->count;
+
+        ho->hvalues = (union hvalue *) arena_zalloc(jf->heap, sizeof(union hvalue) * keep);
         if (0 == ho->count)
-            return 0;
-        fseeko(jf->fin, ho->fpos, SEEK_SET);
-        if (12 < ho->classId) {
-            switch (*(ci->name + 1)) {
-            case 'B':  ho->xclassId = 8;  break;
-            case 'Z':  ho->xclassId = 8;  break;
-            case 'C':  ho->xclassId = 9;  break;
-            case 'S':  ho->xclassId = 9;  break;
-            case 'F':  ho->xclassId = 6;  break;
-            case 'D':  ho->xclassId = 7;  break;
-            case 'I':  ho->xclassId = 10; break;
-            case 'J':  ho->xclassId = 11; break;
-            }
+            return;
+        dump_seek(cur, ho->fpos);
+        switch (*(ci->name + 1)) {
+        case 'B':  ho->xclassId = 8;  break;
+        case 'Z':  ho->xclassId = 8;  break;
+        case 'C':  ho->xclassId = 9;  break;
+        case 'S':  ho->xclassId = 9;  break;
+        case 'F':  ho->xclassId = 6;  break;
+        case 'D':  ho->xclassId = 7;  break;
+        case 'I':  ho->xclassId = 10; break;
+        case 'J':  ho->xclassId = 11; break;
         }
-        switch (ho->xclassId ? ho->xclassId : ho->classId) {
+        switch (ho->xclassId) {
         case 4: case 8: { // BOOLEAN, BYTE
-            char *b = (char *) ho->hvalues;
-            fread(b, sizeof(char), ho->count, jf->fin);
+            copyElements(cur, ho->hvalues, keep);
             size = ho->count;
             break;
         }
         case 5: case 9: {       // CHAR, SHORT
-            unsigned short *c = (unsigned short *) ho->hvalues;
-            fread(c, sizeof(unsigned short), ho->count, jf->fin);
+            copyElements(cur, ho->hvalues, 2 * keep);
             size = 2 * ho->count;
             break;
         }
@@ -1005,247 +1466,497 @@ resolveInstance(struct jdump *jf, hobject *ho)
             size = 8 * ho->count;
             break;
         case 10: {              // INT
-            unsigned int *i = (unsigned int *) ho->hvalues;
-            fread(i, sizeof(unsigned int), ho->count, jf->fin);
+            copyElements(cur, ho->hvalues, 4 * keep);
             size = 4 * ho->count;
             break;
         }
         case 11: {              // LONG
-            unsigned long long *j = (unsigned long long *) ho->hvalues;
-            fread(j, sizeof(unsigned long long), ho->count, jf->fin);
+            copyElements(cur, ho->hvalues, 8 * keep);
             size = 8 * ho->count;
             break;
         }
         }
-        ho->osize = ci->size = size;
-        return ho->osize;
+        ho->osize = size;
+        return;
     } else if (H_OARRAY == ho->htype) {
         if (0 == ho->count)
-            return 0;
-        fseeko(jf->fin, ho->fpos, SEEK_SET);
-        ho->hvalues = talloc_array(ho, union hvalue, ho->count);
-        for (i = 0; i < ho->count; i++) 
-            (ho->hvalues + i)->ident = readIdent(jf);
+            return;
+        dump_seek(cur, ho->fpos);
+        ho->hvalues = (union hvalue *) arena_alloc(jf->heap, sizeof(union hvalue) * ho->count);
         for (i = 0; i < ho->count; i++) {
-            hobject *dref = (hobject *) trbt_lookup32(jf->hTable, (ho->hvalues + i)->ident);
-            if (dref) {
-                ho->csize += resolveInstance(jf, dref);
-                arc_add(jf, ho, dref, 1);
-            }
+            (ho->hvalues + i)->ident = dump_ident(cur, jf->identsz);
+            sweepRef(jf, sw, (ho->hvalues + i)->ident);
         }
-        ho->osize = ci->size = ho->count * jf->identsz;
-        return ho->osize + ho->csize;
+        ho->osize = ho->count * jf->identsz;
+        return;
     }
     
     if (ci->tfields)
-        ho->hvalues = talloc_array(ho, union hvalue, ci->tfields);
-    for (i = 0; i < ci->tfields; i++) {
-        finfo *info = *(ci->values + i);
-        union hvalue *value = (ho->hvalues + i);
-        fseeko(jf->fin, ho->fpos, SEEK_SET);
-        fseek(jf->fin, info->offset, SEEK_CUR);
-        switch (info->ftype) {
-        case '[': 
-        case 'L': {
-            size += jf->identsz;
-            value->ident = readIdent(jf);
-            hobject *dref = (hobject *) trbt_lookup32(jf->hTable, (long) value->ident);
-            if (0 && !dref) 
-                fprintf(stderr, "resolveInstance: cannot resolve Instance 0x%08x in 0x%08x of 0x%08x %s\n",
-                    value->ident, ho->instId, ho->classId, ci->name);
-            if (dref) {
-                ho->csize += resolveInstance(jf, dref);
-                arc_add(jf, ho, dref, 1);
+        ho->hvalues = (union hvalue *) arena_alloc(jf->heap, sizeof(union hvalue) * ci->tfields);
+    // view the field data once, every field is decoded from there
+    dump_seek(cur, ho->fpos);
+    if (NULL == (blob = dump_bytes(cur, ci->isize))) {
+        fprintf(stderr, "loadObj: short instance 0x%llx of %s\n", ho->instId, ci->name);
+        memset(ho->hvalues, 0, sizeof(union hvalue) * ci->tfields);
+        return;
+    }
+    for (cc = ci; cc; cc = cc->super) {
+        const unsigned char *data = blob + (ci->isize - cc->isize);
+        union hvalue *value = ho->hvalues + cc->vbase;
+
+        for (i = 0; i < cc->cfields; i++) {
+            const unsigned char *p = data + cc->foff[i];
+
+            switch (cc->fkind[i]) {
+            case FK_REF:
+                value[i].ident = 4 == jf->identsz ? dump_be32(p) : dump_be64(p);
+                sweepRef(jf, sw, value[i].ident);
+                break;
+            case FK_U1:  value[i].b = *p;  break;
+            case FK_U2:  value[i].c = dump_be16(p);  break;
+            case FK_U4:  value[i].i = dump_be32(p);  break;
+            case FK_U8:  value[i].j = dump_be64(p);  break;
+            default:     value[i].j = 0;  break;
             }
-            break;
-        }
-        case 'Z' : case 'B':
-            size += 1;
-            value->b = getc(jf->fin); break;
-        case 'S' :
-        case 'C' : size += 2;  readUshort(jf->fin, &(value->c)); break;
-        case 'I' : size += 4;  readUint(jf->fin, &(value->i)); break;
-        case 'J' : size += 8;  readUlong(jf->fin, &(value->j)); break;
         }
     }
-    ho->osize = ci->size = size;
-    return ho->osize + ho->csize;
+    ho->osize = ci->isize;
 }
 
-void
-printInstance(struct jdump *jf, hobject *ho, int indent, int pshort, int inString)
+struct graphjob {           // buildGraph state shared by its workers
+    struct jdump *jf;
+    struct refgraph *g;
+    struct refrun *runs;
+};
+
+/* add an edge to the node an identifier names, unless it is null or not in the dump */
+static void
+graphRef(struct jdump *jf, struct refrun *r, long long ident)
 {
-    int i, isString;
+    uint32_t num;
     cinfo *ci;
 
-    if (ho->visit) {
-        printf("[ recursive ] Instance 0x%08x of 0x%08x self %d self+children %d\n",
-            ho->instId, ho->classId, ho->osize, ho->osize + ho->csize);
+    if (0 == ident)
         return;
-    }
-    if (1 < indent && 0 != jf->plimit && indent > jf->plimit)
-        return;
-    if (H_VARRAY == ho->htype) {
-        int def = 0;
-        printf("value array 0x%08x 0x%08x %d count %d size %d\n",
-            ho->instId, ho->classId, ho->xclassId, ho->count, ho->osize);
-        if (ho->count) {
-        if (indent) fputs("\t\t", stdout);
+    if (OBJ_NONE != (num = objtab_lookup(jf->objs, ident)))
+        refrun_add(r, num);
+    else if (NULL != (ci = (cinfo *) idmap_lookup(jf->cTable, ident)))
+        refrun_add(r, jf->objs->n + ci->cnum);
+}
+
+/* read the references of one range of objects, front to back */
+static void
+graphRun(void *arg, int job)
+{
+    struct graphjob *gj = (struct graphjob *) arg;
+    struct jdump *jf = gj->jf;
+    struct refrun *r = gj->runs + job;
+    struct dcursor cur;
+    uint32_t num;
+
+    dump_cursor(jf->store ? jf->store : jf->dump, &cur, 0, -1);
+    for (num = r->lo; num < r->hi; num++) {
+        struct orec *rec = jf->objs->recs + num;
+        cinfo *ci = jf->classes[rec->cls];
+        const unsigned char *blob;
+        unsigned int i;
+
+        refrun_node(gj->g, r, num);
+        if (H_OARRAY == rec->htype) {
+            dump_seek(&cur, rec->fpos);
+            for (i = 0; i < rec->count; i++)
+                graphRef(jf, r, dump_ident(&cur, jf->identsz));
+        } else if (H_INSTANCE == rec->htype && ci->nrefs) {
+            dump_seek(&cur, rec->fpos);
+            if (NULL == (blob = dump_bytes(&cur, ci->isize)))
+                continue;       // loadObj reports it
+            for (i = 0; i < ci->nrefs; i++) {
+                const unsigned char *p = blob + ci->roff[i];
+                graphRef(jf, r, 4 == jf->identsz ? dump_be32(p) : dump_be64(p));
+            }
+        }
+    }
+    dump_release(&cur);
+}
+
+/*
+   Build jf->graph in one pass over the objects.  Node num is object
+   number num, and class number cnum is node jf->objs->n + cnum, whose
+   edges are its static references.  References to null, or to what is
+   not in the dump, are dropped; the rest are kept in field or element
+   order, repeats and all.  The objects are split into ranges that are
+   read on jf->nthreads threads.  jf->rgraph is built from it, and goes
+   with it.
+*/
+void
+buildGraph(struct jdump *jf)
+{
+    size_t nobjs = jf->objs->n;
+    size_t span, njobs = 4 * (size_t) jf->nthreads;
+    struct graphjob gj;
+    struct refrun *r;
+    unsigned int i;
+    int k;
+
+    // the workers only read the decode programs
+    for (i = 0; i < jf->nclasses; i++)
+        resolveClassNode(jf, jf->classes[i]);
+
+    span = (nobjs + njobs - 1) / njobs;
+    njobs = span ? (nobjs + span - 1) / span : 0;
+    talloc_free(jf->graph);
+    gj.jf = jf;
+    gj.g = jf->graph = refgraph_create(NULL, nobjs + jf->nclasses);
+    gj.runs = talloc_array(NULL, struct refrun, njobs + 1);
+    for (k = 0; k < njobs; k++)
+        refrun_start(gj.runs + k, k * span, k + 1 < njobs ? (k + 1) * span : nobjs);
+    tpool_run(jf->nthreads, njobs, graphRun, &gj);
+
+    r = gj.runs + njobs;
+    refrun_start(r, nobjs, nobjs + jf->nclasses);
+    for (i = 0; i < jf->nclasses; i++) {
+        cinfo *ci = jf->classes[i];
+
+        refrun_node(gj.g, r, nobjs + i);
+        for (k = 0; k < ci->cstats; k++) {
+            hobject *sf = ci->statics + k;
+            if ('L' == sf->htype || '[' == sf->htype)
+                graphRef(jf, r, sf->hvalues[0].ident);
+        }
+    }
+    refgraph_join(gj.g, gj.runs, njobs + 1);
+    talloc_free(gj.runs);
+    jf->rgraph = refgraph_reverse(jf->graph, jf->graph);
+    if (debug)
+        printf("reference graph: %zu nodes %llu edges\n", gj.g->n, (unsigned long long) gj.g->nedges);
+}
+
+/* start sizing an object, on top of the walk's stack */
+static void
+resolvePush(struct jdump *jf, struct walk *w, size_t sp, hobject *ho)
+{
+    if (sp == w->max) {
+        w->max = w->max ? 2 * w->max : 1024;
+        w->stack = (hobject **) realloc(w->stack, sizeof(hobject *) * w->max);
+        w->next = (uint64_t *) realloc(w->next, sizeof(uint64_t) * w->max);
+        if (NULL == w->stack || NULL == w->next) {
+            fprintf(stderr, "resolveInstance: cannot stack %zu objects\n", w->max);
+            exit(1);
+        }
+    }
+    objset_add(w->sized, ho->num);
+    ho->csize = 0;
+    loadObj(jf, ho, NULL);
+    w->stack[sp] = ho;
+    w->next[sp] = jf->graph->first[ho->num];
+}
+
+/*
+   Size an object and everything it references, loading what is not
+   loaded yet.  The objects being sized are kept on the walk's stack,
+   not the C stack, so a chain of any length can be followed.  An object
+   met again adds what it has counted so far, as it always did when this
+   recursed.
+*/
+unsigned long
+resolveInstance(struct jdump *jf, struct walk *w, hobject *ho)
+{
+    struct refgraph *g = jf->graph;
+    size_t sp;
+
+    if (objset_test(w->sized, ho->num))
+        return ho->osize + ho->csize;
+    resolvePush(jf, w, 0, ho);
+    sp = 1;
+    while (sp) {
+        hobject *top = w->stack[sp - 1], *dref;
+        uint64_t e = w->next[sp - 1];
+
+        if (e == g->first[top->num + 1]) {
+            // done, count it into the object that referenced it
+            if (--sp)
+                w->stack[sp - 1]->csize += top->osize + top->csize;
+            continue;
+        }
+        w->next[sp - 1]++;
+        // the class nodes are past the objects, their sizes are not counted
+        if (g->to[e] >= jf->objs->n)
+            continue;
+        dref = getObj(jf, g->to[e]);
+        if (objset_test(w->sized, dref->num))
+            top->csize += dref->osize + dref->csize;
+        else
+            resolvePush(jf, w, sp++, dref);
+    }
+    return ho->osize + ho->csize;
+}
+
+/* print to stdout, counting the bytes against the budget of the render */
+static void
+rprintf(struct render *r, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    if (r->stop)
+        return;
+    va_start(ap, fmt);
+    n = vprintf(fmt, ap);
+    va_end(ap);
+    if (0 < n)
+        r->bytes += n;
+    if (r->jf->pbytes && r->bytes >= r->jf->pbytes) {
+        printf(" [ ... ] output limit of %llu bytes reached\n", r->jf->pbytes);
+        r->stop = 1;
+    }
+}
+
+/* start on an object in the render, what has parts to follow is stacked */
+static void
+renderEnter(struct render *r, hobject *ho, int indent, int pshort, int inString)
+{
+    struct jdump *jf = r->jf;
+    struct walk *w = r->w;
+    cinfo *ci = jf->classes[ho->cnum];
+    struct pframe *f;
+    int i;
+
+    if (objset_test(w->shown, ho->num)) {
+        rprintf(r, "[ recursive ] Instance 0x%08llx of 0x%08llx self %d self+children %d\n",
+            ho->instId, ci->ident, ho->osize, ho->osize + ho->csize);
+        return;
+    }
+    if (1 < indent && 0 != jf->plimit && indent > jf->plimit) {
+        // the field or element it is in has been started, end its line
+        rprintf(r, "[ ... ] 0x%08llx %s\n", ho->instId, ci->name);
+        return;
+    }
+    if (H_VARRAY == ho->htype) {
+        rprintf(r, "value array 0x%08llx 0x%08llx %d count %d size %d\n",
+            ho->instId, ci->ident, ho->xclassId, ho->count, ho->osize);
+        if (ho->count) {
+        if (indent) rprintf(r, "\t\t");
         for (i = 0; i < ho->count; i++) {
-            if (100 < i) {
-                printf("[ ... ] %d elements ", ho->count - i);
+            if (ARRAY_PRINT < i) {
+                rprintf(r, "[ ... ] %d elements ", ho->count - i);
                 break;
             }
-            switch (ho->xclassId ? ho->xclassId : ho->classId) {
+            switch (ho->xclassId) {
             case 4: case 8: {
                 char *b = (char *) ho->hvalues;
-                printf("%x ", *(b + i)); break; }
+                rprintf(r, "%x ", *(b + i)); break; }
             case 5: {
                 unsigned short *c = (unsigned short *) ho->hvalues;
-                putchar(*(c + i) >> 8); break; }
+                rprintf(r, "%c", *(c + i) >> 8); break; }
             case 9: {
                 unsigned short *c = (unsigned short *) ho->hvalues;
                 if (!inString)
-                    printf("%x ", *(c + i)); 
+                    rprintf(r, "%x ", *(c + i)); 
                 else 
-                    printf("%c", *(c + i) >> 8);
+                    rprintf(r, "%c", *(c + i) >> 8);
                 break; }
             case 10: {
                 unsigned int *pi = (unsigned int *) ho->hvalues;
-                printf("%x ", *(pi + i)); break; }
+                rprintf(r, "%x ", *(pi + i)); break; }
             case 11: {
                 unsigned long long *j = (unsigned long long *) ho->hvalues;
-                printf("%lx ", *(j + i)); break; }
+                rprintf(r, "%lx ", *(j + i)); break; }
             }
         }
         }
-        if (!def) puts("");
+        rprintf(r, "\n");
         return;
     } else if (H_OARRAY == ho->htype) {
-        int last_cnt = 0;
-        unsigned long long last_pid = ~0;
-        unsigned long long *pid = (unsigned long long *) ho->hvalues;
-        hobject *dref;
-        printf("object array 0x%08x 0x%08x count %d size %d\n",
-            ho->instId, ho->classId, ho->count, ho->osize);
-        if (ho->count) {
-        for (i = 0; i < ho->count; i++) {
-            if (pshort && 0 == *(pid + i))
-                continue;
-            if (0 && pshort && 5 < i) {
-                if (0 != last_cnt)
-                    printf(" [ %d elements ]\n", last_cnt);
-                last_cnt = 0;
-                if (indent) fputs("\t\t\t", stdout);
-                puts("[....]");
-                break;
-            }
-            if (*(pid + i) && (dref = (hobject *) trbt_lookup32(jf->hTable, (long) *(pid + i)))) {
-                if (0 != last_cnt)
-                    printf(" [ %d elements ]\n", last_cnt);
-                last_cnt = 0;
-                printInstance(jf, dref, 1 + indent, 0, 0);
-            } else if (last_pid != *(pid + i)) {
-                if (0 != last_cnt)
-                    printf(" [ %d elements ]\n", last_cnt);
-                if (indent) fputs("\t\t\t", stdout);
-                if (0 == *(pid + i))
-                    printf("[null]");
-                else 
-                    printf("Instance 0x%08x of 0x%08x %s", *(pid + i), 0, "unknown");
-                last_cnt = 1;
-                last_pid = *(pid + i);
-            } else
-                last_cnt++;
+        rprintf(r, "object array 0x%08llx 0x%08llx count %d size %d\n",
+            ho->instId, ci->ident, ho->count, ho->osize);
+        if (0 == ho->count)
+            return;
+    } else {
+        // if (indent) fputs("\t\t", stdout);
+        rprintf(r, "Instance 0x%08llx of 0x%08llx %s self %d self+children %ld",
+            ho->instId, ci->ident, ci->name, ho->osize, ho->osize + ho->csize);
+        if (jf->dom)
+            rprintf(r, " retained %llu", (unsigned long long) jf->dom->retained[ho->num]);
+        rprintf(r, "\n");
+        if (pshort)
+            return;
+        objset_add(w->shown, ho->num);
+        if (w->nexpanded == w->maxexpanded) {
+            w->maxexpanded = w->maxexpanded ? 2 * w->maxexpanded : 256;
+            w->expanded = (uint32_t *) realloc(w->expanded, sizeof(uint32_t) * w->maxexpanded);
         }
-        if (0 != last_cnt)
-            printf(" [ %d elements ]\n", last_cnt);
+        w->expanded[w->nexpanded++] = ho->num;
+        if (indent)
+            rprintf(r, "\t\t----> (%d)\n", indent);
+        inString = ci == jf->javaLangString;
+    }
+
+    if (r->sp == w->maxframes) {
+        w->maxframes = w->maxframes ? 2 * w->maxframes : 256;
+        w->frames = (struct pframe *) realloc(w->frames, sizeof(struct pframe) * w->maxframes);
+        if (NULL == w->frames) {
+            fprintf(stderr, "printInstance: cannot stack %zu objects\n", w->maxframes);
+            exit(1);
         }
-        return;
     }
+    f = w->frames + r->sp++;
+    f->ho = ho;
+    f->indent = indent;
+    f->pshort = pshort;
+    f->inString = inString;
+    f->i = 0;
+    f->last_cnt = 0;
+    f->last_pid = ~0;
+}
 
-    ci = (cinfo *) trbt_lookup32(jf->cTable, ho->classId);
-    // if (indent) fputs("\t\t", stdout);
-    printf("Instance 0x%08x of 0x%08x %s self %d self+children %ld\n",
-        ho->instId, ho->classId, ci->name, ho->osize, ho->osize + ho->csize);
-    if (pshort)
-        return;
-    ho->visit = 1;
-    if (indent)
-        printf("\t\t----> (%d)\n", indent);
-    isString = ci == jf->javaLangString;
-    for (i = 0; i < ci->tfields; i++) {
-        finfo *info = *(ci->values + i);
-        union hvalue *value = ho->hvalues + i;
-        
-        if (indent) fputs("\t", stdout);
-        printf("\t%3d (%3d): %c %-25s ", i, info->offset, info->ftype, info->name);
+/* go on with the elements of an object array, up to the next one to follow */
+static void
+renderElements(struct render *r, struct pframe *f)
+{
+    struct jdump *jf = r->jf;
+    hobject *ho = f->ho, *dref;
+    unsigned long long *pid = (unsigned long long *) ho->hvalues;
+    int i;
+
+    while (f->i < ho->count) {
+        i = f->i++;
+        if (jf->pbreadth && i >= jf->pbreadth) {
+            if (0 != f->last_cnt)
+                rprintf(r, " [ %d elements ]\n", f->last_cnt);
+            f->last_cnt = 0;
+            if (f->indent) rprintf(r, "\t\t\t");
+            rprintf(r, "[ ... ] %d elements\n", ho->count - i);
+            break;
+        }
+        if (f->pshort && 0 == *(pid + i))
+            continue;
+        if (*(pid + i) && (dref = findObj(jf, *(pid + i)))) {
+            if (0 != f->last_cnt)
+                rprintf(r, " [ %d elements ]\n", f->last_cnt);
+            f->last_cnt = 0;
+            renderEnter(r, dref, 1 + f->indent, 0, 0);
+            return;
+        } else if (f->last_pid != *(pid + i)) {
+            if (0 != f->last_cnt)
+                rprintf(r, " [ %d elements ]\n", f->last_cnt);
+            if (f->indent) rprintf(r, "\t\t\t");
+            if (0 == *(pid + i))
+                rprintf(r, "[null]");
+            else 
+                rprintf(r, "Instance 0x%08llx of 0x%08llx %s", *(pid + i), 0LL, "unknown");
+            f->last_cnt = 1;
+            f->last_pid = *(pid + i);
+        } else
+            f->last_cnt++;
+    }
+    if (0 != f->last_cnt)
+        rprintf(r, " [ %d elements ]\n", f->last_cnt);
+    r->sp--;
+}
+
+/* go on with the fields of an instance, up to the next reference to follow */
+static void
+renderFields(struct render *r, struct pframe *f)
+{
+    struct jdump *jf = r->jf;
+    hobject *ho = f->ho;
+    cinfo *ci = jf->classes[ho->cnum];
+    int i;
+
+    while (f->i < ci->tfields) {
+        unsigned int off;
+        finfo *info;
+        union hvalue *value;
+
+        i = f->i++;
+        info = fieldAt(ci, i, &off);
+        value = ho->hvalues + i;
+        if (f->indent) rprintf(r, "\t");
+        rprintf(r, "\t%3d (%3d): %c %-25s ", i, off, info->ftype, info->name);
         switch (info->ftype) {
         case '[' :
         case 'L' : {
             hobject *dref;
-            if (value->ident && (dref = (hobject *) trbt_lookup32(jf->hTable, (long) value->ident)))
-                printInstance(jf, dref, 1 + indent, 0, isString);
-            else if (0 == value->ident)
-                puts("[null]");
+            if (value->ident && (dref = findObj(jf, value->ident))) {
+                renderEnter(r, dref, 1 + f->indent, 0, f->inString);
+                return;
+            } else if (0 == value->ident)
+                rprintf(r, "[null]\n");
             else
-                printf("Instance 0x%08x of 0x%08x %s\n", value->ident, 0, "unknown");
+                rprintf(r, "Instance 0x%08llx of 0x%08llx %s\n", value->ident, 0LL, "unknown");
             break;
         }
         case 'B' :
-        case 'Z' :  printf(" %d  0x%x\n", value->b, value->b);  break;
+        case 'Z' :  rprintf(r, " %d  0x%x\n", value->b, value->b);  break;
         case 'C' :
-        case 'S' :  printf(" %d  0x%x\n", value->c, value->c);  break;
-        case 'I' :  printf(" %d  0x%x\n", value->i, value->i);  break;
-        case 'J' :  printf(" %ld  0x%lx\n", value->j, value->j);  break;
-        default: puts(" 0 0 ");
+        case 'S' :  rprintf(r, " %d  0x%x\n", value->c, value->c);  break;
+        case 'I' :  rprintf(r, " %d  0x%x\n", value->i, value->i);  break;
+        case 'J' :  rprintf(r, " %ld  0x%lx\n", value->j, value->j);  break;
+        default: rprintf(r, " 0 0 \n");
         }
     }
-    if (indent)
-        printf("\t\t<---- (%d)\n", indent);
+    if (f->indent)
+        rprintf(r, "\t\t<---- (%d)\n", f->indent);
     fflush(stdout);
+    r->sp--;
+}
 
-    if (0)
-    for (i = 0; i < ci->tfields; i++) {
-        finfo *info = *(ci->values + i);
-        printf(" [%3d:%3d:0x%08x ] ", i, info->offset, ho->instId);
-        union hvalue *value = ho->hvalues + i;
-        switch (info->ftype) {
-        case '[' :
-        case 'L' : {
-            hobject *dref = (hobject *) trbt_lookup32(jf->hTable, (long) value->ident);
-            if (dref)
-                printInstance(jf, dref, indent, 0, 0);
-            break;
-            }
-        default:  break;
-        }
+/*
+   Print an object and, depth first, what it references.  The objects
+   being printed are kept on the walk's frame stack, not the C stack, and
+   the output goes out as it is made.  -l bounds the depth, -e the
+   elements of an object array that are looked at, and -o the bytes
+   printed for one object, after which the rest of it is dropped.
+*/
+void
+printInstance(struct jdump *jf, struct walk *w, hobject *ho, int indent, int pshort, int inString)
+{
+    struct render r;
+
+    // an object is only recursive within one print, not because an
+    // earlier, unrelated one expanded it
+    while (w->nexpanded)
+        objset_del(w->shown, w->expanded[--w->nexpanded]);
+
+    r.jf = jf;
+    r.w = w;
+    r.sp = 0;
+    r.bytes = 0;
+    r.stop = 0;
+    renderEnter(&r, ho, indent, pshort, inString);
+    while (r.sp && !r.stop) {
+        struct pframe *f = w->frames + r.sp - 1;
+
+        if (H_OARRAY == f->ho->htype)
+            renderElements(&r, f);
+        else
+            renderFields(&r, f);
     }
-
-    return;
+    fflush(stdout);
 }
 
 void
-printString(struct jdump *jf, hobject *ho)
+printString(struct jdump *jf, struct walk *w, hobject *ho)
 {
     int i;
-    cinfo *ci = (cinfo *) trbt_lookup32(jf->cTable, ho->classId);
-    printf("Instance 0x%08x of 0x%08x %s\n", ho->instId, ho->classId, ci->name);
+    cinfo *ci = jf->classes[ho->cnum];
+    printf("Instance 0x%08llx of 0x%08llx %s\n", ho->instId, ci->ident, ci->name);
     for (i = 0; i < ci->tfields; i++) {
-        finfo *info = *(ci->values + i);
+        unsigned int off;
+        finfo *info = fieldAt(ci, i, &off);
         union hvalue *value = ho->hvalues + i;
         
-        printf("\t%3d (%3d): %c %-25s ", i, info->offset, info->ftype, info->name);
+        printf("\t%3d (%3d): %c %-25s ", i, off, info->ftype, info->name);
         switch (info->ftype) {
         case '[' :
         case 'L' : {
             hobject *dref;
-            if (value->ident && (dref = (hobject *) trbt_lookup32(jf->hTable, (long) value->ident)))
-                printInstance(jf, dref, 1, 1, 1);
+            if (value->ident && (dref = findObj(jf, value->ident)))
+                printInstance(jf, w, dref, 1, 1, 1);
             else if (0 == value->ident)
                 puts("[null]");
             else
-                printf("Instance 0x%08x of 0x%08x %s\n", value->ident, 0, "unknown");
+                printf("Instance 0x%08llx of 0x%08llx %s\n", value->ident, 0LL, "unknown");
             break;
         }
         case 'B' :
@@ -1260,766 +1971,1414 @@ printString(struct jdump *jf, hobject *ho)
 }
 
 void 
-printInstances(struct jdump *jf, trbt_node_t *node)
+printInstances(struct jdump *jf, struct walk *w)
 {
-    if (NULL == node)
-        return;
-    printInstances(jf, node->left);
-    printf("begin node %x\n", node->data);
-    printInstance(jf, (hobject *) node->data, 0, 0, 0);
-    printf("end node %x\n\n", node->data);
-    printInstances(jf, node->right);
+    hobject *ho;
+    uint32_t i;
+
+    for (i = 0; i < jf->objs->n; i++) {
+        ho = getObj(jf, i);
+        printf("begin node %x\n", ho);
+        printInstance(jf, w, ho, 0, 0, 0);
+        printf("end node %x\n\n", ho);
+    }
 }
 
 void
-collectStats(struct jdump *jf, trbt_node_t *node, unsigned long ckey)
+collectStats(struct jdump *jf, struct walk *w, const char *sel)
 {
+    struct sweep sw = { 0 };
     hobject *ho;
-    if (NULL == node)
+    uint32_t i;
+
+    for (i = 0; i < jf->objs->n; i++)
+        if (sel[jf->objs->recs[i].cls])
+            sweepAdd(jf, &sw, i);
+    resolveSweep(jf, &sw);
+
+    for (i = 0; i < jf->objs->n; i++) {
+        if (sel[jf->objs->recs[i].cls]) {
+            ho = getObj(jf, i);
+            resolveInstance(jf, w, ho);
+            printInstance(jf, w, ho, 0, 0, 0);
+        }
+    }
+}
+
+/* name a graph node, an object or the statics of a class */
+static void
+printNode(struct jdump *jf, uint32_t node)
+{
+    struct orec *rec;
+
+    if (node >= jf->objs->n) {
+        cinfo *ci = jf->classes[node - jf->objs->n];
+        printf("class 0x%08llx %s", ci->ident, ci->name);
+        return;
+    }
+    rec = jf->objs->recs + node;
+    if (H_OARRAY == rec->htype)
+        printf("object array 0x%08llx %s", (long long) rec->ident, jf->classes[rec->cls]->name);
+    else
+        printf("instance 0x%08llx %s", (long long) rec->ident, jf->classes[rec->cls]->name);
+}
+
+struct rcount {             // referrers of one kind, see printReferrers
+    unsigned long count;
+    unsigned int cnum;
+    int statics;            // class statics, not objects of the class
+};
+
+static int
+rcountCompare(const void *a, const void *b)
+{
+    const struct rcount *l = (const struct rcount *) a, *r = (const struct rcount *) b;
+
+    if (l->count != r->count)
+        return l->count < r->count ? 1 : -1;
+    return l->cnum != r->cnum ? (l->cnum < r->cnum ? -1 : 1) : l->statics - r->statics;
+}
+
+/*
+   List the referrers of one object, given by identifier, or count the
+   referrers of all the instances of a class pattern by their class.
+   A referrer that holds several references to the same object is
+   counted once for it.
+*/
+void
+printReferrers(struct jdump *jf, const char *what)
+{
+    struct refgraph *rg = jf->rgraph;
+    size_t nobjs = jf->objs->n;
+    uint32_t num, node;
+    uint64_t e;
+
+    if (isdigit((unsigned char) what[0])) {
+        long long ident = strtoull(what, NULL, 0);
+        cinfo *ci;
+
+        if (OBJ_NONE != (num = objtab_lookup(jf->objs, ident)))
+            node = num;
+        else if (NULL != (ci = (cinfo *) idmap_lookup(jf->cTable, ident)))
+            node = nobjs + ci->cnum;
+        else {
+            printf("referrers: 0x%llx not found\n", ident);
+            return;
+        }
+        printf("\nReferrers of ");
+        printNode(jf, node);
+        printf(", %llu references\n", (unsigned long long) refgraph_degree(rg, node));
+        for (e = rg->first[node]; e < rg->first[node + 1]; e++) {
+            if (e > rg->first[node] && rg->to[e] == rg->to[e - 1])
+                continue;
+            printf("\t");
+            printNode(jf, rg->to[e]);
+            printf("\n");
+        }
+    } else {
+        char *sel = talloc_zero_array(NULL, char, jf->nclasses);
+        struct rcount *rc = talloc_zero_array(sel, struct rcount, 2 * jf->nclasses);
+        unsigned long nsel = 0;
+        unsigned int i, n = 0;
+
+        if (!selectClasses(jf, what, sel)) {
+            printf("referrers: \'%s\' not found\n", what);
+            talloc_free(sel);
+            return;
+        }
+        for (num = 0; num < nobjs; num++) {
+            if (!sel[jf->objs->recs[num].cls])
+                continue;
+            nsel++;
+            for (e = rg->first[num]; e < rg->first[num + 1]; e++) {
+                uint32_t from = rg->to[e];
+
+                if (e > rg->first[num] && from == rg->to[e - 1])
+                    continue;
+                if (from >= nobjs)
+                    rc[2 * (from - nobjs) + 1].count++;
+                else
+                    rc[2 * jf->objs->recs[from].cls].count++;
+            }
+        }
+        for (i = 0; i < 2 * jf->nclasses; i++) {
+            if (rc[i].count) {
+                rc[n].count = rc[i].count;
+                rc[n].cnum = i / 2;
+                rc[n++].statics = i % 2;
+            }
+        }
+        qsort(rc, n, sizeof(struct rcount), rcountCompare);
+        printf("\nReferrers of %lu objects of \'%s\'\n", nsel, what);
+        for (i = 0; i < n; i++)
+            printf("\t%10lu %s%s\n", rc[i].count, jf->classes[rc[i].cnum]->name,
+                rc[i].statics ? " statics" : "");
+        talloc_free(sel);
+    }
+}
+
+/* the bytes of object number num, as loadObj counts them, without loading it */
+static uint64_t
+objSize(struct jdump *jf, uint32_t num)
+{
+    struct orec *rec = jf->objs->recs + num;
+    cinfo *ci = jf->classes[rec->cls];
+
+    if (H_OARRAY == rec->htype)
+        return (uint64_t) rec->count * jf->identsz;
+    if (H_VARRAY == rec->htype)
+        return (uint64_t) rec->count * sigSize(jf, ci->name[1]);
+    return ci->isize;
+}
+
+struct rootnodes {          // graph nodes of the roots, see rootNodes
+    struct jdump *jf;
+    uint32_t *nodes;
+    size_t n;
+};
+
+static void
+rootNode(void *param, void *data)
+{
+    struct rootnodes *rn = (struct rootnodes *) param;
+    struct jdump *jf = rn->jf;
+    rinfo *ri = (rinfo *) data;
+    uint32_t num;
+    cinfo *ci;
+
+    if (OBJ_NONE != (num = objtab_lookup(jf->objs, ri->ident)))
+        rn->nodes[rn->n++] = num;
+    else if (NULL != (ci = (cinfo *) idmap_lookup(jf->cTable, ri->ident)))
+        rn->nodes[rn->n++] = jf->objs->n + ci->cnum;
+}
+
+/* the graph nodes of the roots that are in the dump, in order, *n of them */
+static uint32_t *
+rootNodes(struct jdump *jf, size_t *n)
+{
+    struct rootnodes rn;
+
+    rn.jf = jf;
+    rn.n = 0;
+    rn.nodes = talloc_array(NULL, uint32_t, jf->roots->count + 1);
+    idmap_traverse(jf->roots, rootNode, &rn);
+    qsort(rn.nodes, rn.n, sizeof(uint32_t), numCompare);
+    *n = rn.n;
+    return rn.nodes;
+}
+
+/* build jf->dom over jf->graph, from every root of the dump */
+void
+buildDominators(struct jdump *jf)
+{
+    uint32_t *roots;
+    uint64_t *self;
+    size_t i, nroots;
+
+    roots = rootNodes(jf, &nroots);
+
+    // classes take no bytes of their own
+    self = talloc_zero_array(roots, uint64_t, jf->graph->n);
+    for (i = 0; i < jf->objs->n; i++)
+        self[i] = objSize(jf, i);
+
+    talloc_free(jf->dom);
+    jf->dom = domtree_build(jf->graph, jf->graph, jf->rgraph, roots, nroots, self);
+    if (debug)
+        printf("dominators: %zu roots %zu reachable\n", nroots, jf->dom->nreach - 1);
+    talloc_free(roots);
+}
+
+#define DOM_TOP 25          // objects listed by printDominators
+
+/* keep the max largest (key, node) pairs offered, largest first, returns how many are kept */
+static int
+keepLargest(uint32_t *top, uint64_t *tkey, int ntop, int max, uint32_t node, uint64_t key)
+{
+    int j;
+
+    if (max == ntop && key <= tkey[ntop - 1])
+        return ntop;
+    if (max > ntop)
+        ntop++;
+    for (j = ntop - 1; j > 0 && tkey[j - 1] < key; j--) {
+        top[j] = top[j - 1];
+        tkey[j] = tkey[j - 1];
+    }
+    top[j] = node;
+    tkey[j] = key;
+    return ntop;
+}
+
+struct cretained {          // bytes retained by the instances of a class
+    uint64_t bytes;
+    unsigned long count;
+    unsigned int cnum;
+};
+
+static int
+cretainedCompare(const void *a, const void *b)
+{
+    const struct cretained *l = (const struct cretained *) a, *r = (const struct cretained *) b;
+
+    if (l->bytes != r->bytes)
+        return l->bytes < r->bytes ? 1 : -1;
+    return l->cnum < r->cnum ? -1 : l->cnum > r->cnum;
+}
+
+/*
+   Print the classes by the bytes their instances retain together, then
+   the objects that retain the most.  An instance dominated by another
+   instance of its class is already counted with that one, so the
+   dominator tree is walked keeping a count of each class on the path.
+*/
+void
+printDominators(struct jdump *jf)
+{
+    struct domtree *dt = jf->dom;
+    struct refgraph *tree = dt->tree;
+    size_t nobjs = jf->objs->n, root = dt->n;
+    struct cretained *cr = talloc_zero_array(NULL, struct cretained, jf->nclasses);
+    uint32_t *onpath = talloc_zero_array(cr, uint32_t, jf->nclasses);
+    uint32_t *stack = talloc_array(cr, uint32_t, dt->nreach + 1);
+    uint64_t *pos = talloc_array(cr, uint64_t, dt->nreach + 1);
+    uint32_t top[DOM_TOP];
+    uint64_t tkey[DOM_TOP];
+    unsigned long nlost = 0;
+    uint64_t lost = 0;
+    size_t sp, i;
+    int j, ntop = 0;
+
+    stack[0] = root;
+    pos[0] = tree->first[root];
+    sp = 1;
+    while (sp) {
+        uint32_t v = stack[sp - 1], c;
+
+        if (pos[sp - 1] == tree->first[v + 1]) {
+            if (v < nobjs)
+                onpath[jf->objs->recs[v].cls]--;
+            sp--;
+            continue;
+        }
+        c = tree->to[pos[sp - 1]++];
+        if (c < nobjs) {
+            struct cretained *cc = cr + jf->objs->recs[c].cls;
+
+            if (0 == onpath[jf->objs->recs[c].cls]++)
+                cc->bytes += dt->retained[c];
+            cc->count++;
+        }
+        stack[sp] = c;
+        pos[sp++] = tree->first[c];
+    }
+
+    for (i = 1; i < dt->nreach; i++)
+        ntop = keepLargest(top, tkey, ntop, DOM_TOP, dt->order[i], dt->retained[dt->order[i]]);
+    for (i = 0; i < nobjs; i++) {
+        if (DOM_NONE == dt->idom[i]) {
+            nlost++;
+            lost += objSize(jf, i);
+        }
+    }
+
+    for (i = 0; i < jf->nclasses; i++)
+        cr[i].cnum = i;
+    qsort(cr, jf->nclasses, sizeof(struct cretained), cretainedCompare);
+
+    puts("\nRetained Summary");
+    printf("\t%lu objects reachable from the roots retain %llu bytes\n",
+        (unsigned long) (nobjs - nlost), (unsigned long long) dt->retained[root]);
+    printf("\t%lu objects unreachable, %llu bytes\n", nlost, (unsigned long long) lost);
+    printf("\t%14s %10s %s\n", "retained", "objects", "class");
+    for (i = 0; i < jf->nclasses; i++)
+        if (cr[i].count)
+                printf("\t%14llu %10lu %s\n", (unsigned long long) cr[i].bytes, cr[i].count,
+                jf->classes[cr[i].cnum]->name);
+
+    puts("\nLargest Retained");
+    for (j = 0; j < ntop; j++) {
+        printf("\t%14llu ", (unsigned long long) tkey[j]);
+        printNode(jf, top[j]);
+        putchar('\n');
+    }
+    talloc_free(cr);
+}
+
+
+static const char *rootNames[] = {
+    "", "jni global", "jni local", "java frame", "native stack",
+    "system class", "thread block", "monitor", "thread", "unknown"
+};
+
+static long long
+nodeIdent(struct jdump *jf, uint32_t node)
+{
+    if (node >= jf->objs->n)
+        return jf->classes[node - jf->objs->n]->ident;
+    return jf->objs->recs[node].ident;
+}
+
+/* print the field, element or static of node from that refers to node to */
+static void
+printStep(struct jdump *jf, uint32_t from, uint32_t to)
+{
+    long long ident = nodeIdent(jf, to);
+    unsigned int i, off;
+
+    if (from >= jf->objs->n) {
+        cinfo *ci = jf->classes[from - jf->objs->n];
+
+        for (i = 0; i < ci->cstats; i++) {
+            hobject *sf = ci->statics + i;
+
+            if (('L' == sf->htype || '[' == sf->htype) && ident == sf->hvalues[0].ident) {
+                printf("static %s", getString(jf, sf->instId));
+                return;
+            }
+        }
+    } else {
+        hobject *ho = getObj(jf, from);
+        cinfo *ci = jf->classes[ho->cnum];
+
+        loadObj(jf, ho, NULL);
+        if (H_OARRAY == ho->htype) {
+            for (i = 0; i < ho->count; i++) {
+                if (ident == ho->hvalues[i].ident) {
+                    printf("[%u] (%u)", i, i * jf->identsz);
+                    return;
+                }
+            }
+        } else {
+            for (i = 0; i < ci->nrefs; i++) {
+                if (ident == ho->hvalues[ci->refs[i]].ident) {
+                    finfo *fi = fieldAt(ci, ci->refs[i], &off);
+                    printf(".%s (%u)", fi->name, off);
+                    return;
+                }
+            }
+        }
+    }
+    printf("?");
+}
+
+struct pathsearch {         // printPath state, kept from one search to the next
+    struct objset *isroot;
+    struct objset *seen;
+    uint32_t *next;         // the next node toward the target, by node
+    uint32_t *queue;
+};
+
+/*
+   Find a shortest chain of references from a root to node target, by
+   a breadth first search back through the referrers, and print it root
+   first.  Only the nodes closer to the target than the nearest root
+   are visited.
+*/
+static void
+printPath(struct jdump *jf, struct pathsearch *ps, uint32_t target)
+{
+    struct refgraph *rg = jf->rgraph;
+    uint32_t found = OBJ_NONE, v, steps = 0;
+    size_t head = 0, tail = 0;
+    uint64_t e;
+    rinfo *ri;
+
+    objset_clear(ps->seen);
+    objset_add(ps->seen, target);
+    ps->queue[tail++] = target;
+    if (objset_test(ps->isroot, target))
+        found = target;
+    while (OBJ_NONE == found && head < tail) {
+        v = ps->queue[head++];
+        for (e = rg->first[v]; e < rg->first[v + 1]; e++) {
+            uint32_t u = rg->to[e];
+
+            if (!objset_add(ps->seen, u))
+                continue;
+            ps->next[u] = v;
+            if (objset_test(ps->isroot, u)) {
+                found = u;
+                break;
+            }
+            ps->queue[tail++] = u;
+        }
+    }
+
+    printf("\nPath to ");
+    printNode(jf, target);
+    if (OBJ_NONE == found) {
+        puts(", not reachable from a root");
         return;
-    collectStats(jf, node->left, ckey);
-    ho = (hobject *) node->data;
-    if (ckey == ho->classId) {
-        resolveInstance(jf, ho);
-        printInstance(jf, ho, 0, 0, 0);
     }
-    collectStats(jf, node->right, ckey);
+    for (v = found; v != target; v = ps->next[v])
+        steps++;
+    printf(", depth %u\n", steps);
+
+    ri = (rinfo *) idmap_lookup(jf->roots, nodeIdent(jf, found));
+    printf("\t%s root ", ri && ri->rtype < sizeof(rootNames) / sizeof(rootNames[0]) ? rootNames[ri->rtype] : "");
+    printNode(jf, found);
+    putchar('\n');
+    for (v = found; v != target; v = ps->next[v]) {
+        printf("\t    ");
+        printStep(jf, v, ps->next[v]);
+        putchar(' ');
+        printNode(jf, ps->next[v]);
+        putchar('\n');
+    }
+}
+
+/*
+   Print a shortest path from a root to one object, given by identifier,
+   or to each of the jf->npaths largest instances of a class pattern, by
+   retained size with -D, by their own size otherwise.
+*/
+void
+printPaths(struct jdump *jf, const char *what)
+{
+    struct pathsearch ps;
+    size_t nroots, nobjs = jf->objs->n, i;
+    uint32_t *roots = rootNodes(jf, &nroots);
+    uint32_t *top = talloc_array(roots, uint32_t, jf->npaths);
+    uint64_t *tkey = talloc_array(roots, uint64_t, jf->npaths);
+    int j, ntop = 0;
+
+    ps.isroot = objset_create(roots, jf->graph->n);
+    ps.seen = objset_create(roots, jf->graph->n);
+    ps.next = talloc_array(roots, uint32_t, jf->graph->n);
+    ps.queue = talloc_array(roots, uint32_t, jf->graph->n);
+    for (i = 0; i < nroots; i++)
+        objset_add(ps.isroot, roots[i]);
+
+    if (isdigit((unsigned char) what[0])) {
+        long long ident = strtoull(what, NULL, 0);
+        cinfo *ci;
+
+        if (OBJ_NONE != (top[0] = objtab_lookup(jf->objs, ident)))
+            ntop = 1;
+        else if (NULL != (ci = (cinfo *) idmap_lookup(jf->cTable, ident))) {
+            top[0] = nobjs + ci->cnum;
+            ntop = 1;
+        } else
+            printf("paths: 0x%llx not found\n", ident);
+    } else {
+        char *sel = talloc_zero_array(roots, char, jf->nclasses);
+
+        if (selectClasses(jf, what, sel)) {
+            for (i = 0; i < nobjs; i++)
+                if (sel[jf->objs->recs[i].cls])
+                    ntop = keepLargest(top, tkey, ntop, jf->npaths, i,
+                        jf->dom ? jf->dom->retained[i] : objSize(jf, i));
+        } else
+            printf("paths: \'%s\' not found\n", what);
+    }
+    for (j = 0; j < ntop; j++)
+        printPath(jf, &ps, top[j]);
+    talloc_free(roots);
 }
 
 unsigned int 
-countbytes(FILE *fin, unsigned int sz)
+countbytes(struct dcursor *cur, unsigned int sz)
 {
     unsigned int count = 0;
-    int bb;
 
-    while (sz > 0 && EOF != (bb = getc(fin))) {
-        if (0 < bb) 
+    while (sz > 0 && 0 < dump_left(cur)) {
+        if (0 < dump_u1(cur)) 
             count++;
         sz--;
     }
     return count;
 }
 
-void
-readHeap(struct jdump *jf, unsigned int hsize)
+rinfo *
+addRoot(hpart *hp, long long id, int rtype)
 {
-    unsigned char rtype;
-    long roott, rootg, rootl, frame, stack, sclass, tblock, monitor, cclass, inst, oarr, parr;
-
+    rinfo *ri;
 
-    roott = rootg = rootl = frame = stack = sclass = tblock = monitor = cclass = inst = oarr = parr = 0;
+    if (hp->nroots == hp->maxroots) {
+        hp->maxroots = hp->maxroots ? 2 * hp->maxroots : 256;
+        hp->roots = talloc_realloc(hp, hp->roots, rinfo, hp->maxroots);
+    }
+    ri = hp->roots + hp->nroots++;
+    ri->ident = id;
+    ri->ref = 0;
+    ri->rtype = rtype;
+    ri->desc = NULL;
+    return ri;
+}
 
-    jf->javaLangString = findClass(jf, "java/lang/String");
+/*
+   Decode the sub-records of one heap part.  This runs on a worker thread,
+   so it only reads the shared tables; everything that has to be inserted
+   is queued in the part and applied by mergeHeap in file order.
+*/
+void
+decodePart(struct jdump *jf, hpart *hp, struct dcursor *cur)
+{
+    hstats *st = &hp->st;
+    off_t end = hp->off + hp->len;
+    unsigned char rtype;
 
-    while (0 < hsize && EOF != (rtype = getc(jf->fin))) {
-        rinfo *ri;
-        hsize--;
+    while (dump_tell(cur) < end && !cur->err) {
+        rtype = dump_u1(cur);
         switch (rtype) {
         case 0xff : {    // HPROF_GC_ROOT_UNKNOWN
-            long long id = readIdent(jf);
-            hsize -= jf->identsz;
+            long long id = dump_ident(cur, jf->identsz);
             puts("\t heap root unknown");
+            addRoot(hp, id, ROOT_UNKNOWN);
             break;
         }
         case 0x08 : {   // HPROF_GC_ROOT_THREAD_OBJ
             int threadSeq, stackSeq;
-            long long id = readIdent(jf);
-            readUint(jf->fin, &threadSeq);
-            readUint(jf->fin, &stackSeq);
-            hsize -= jf->identsz + 8;
+            long long id = dump_ident(cur, jf->identsz);
+            threadSeq = dump_u4(cur);
+            stackSeq = dump_u4(cur);
             if (debug)
             printf("0x%08lx root thread obj thread:%d stack:%d\n", id, threadSeq, stackSeq);
             // putchar('r');
-            roott++;
+            addRoot(hp, id, ROOT_THREAD_OBJ);
+            st->roott++;
             break;
         }
         case 0x01 : {   // HPROF_GC_ROOT_JNI_GLOBAL
             long long id, gid;
-            id = readIdent(jf);
-            gid = readIdent(jf);
-            hsize -= jf->identsz + jf->identsz;
+            id = dump_ident(cur, jf->identsz);
+            gid = dump_ident(cur, jf->identsz);
             if (debug)
                 printf("0x%08lx root native static 0x%08lx\n", id, gid);
-            ri = mkrinfo(jf->roots, id, 0, ROOT_NATIVE_STATIC, "");
-            trbt_insert32(jf->roots, (long) id, ri);
+            addRoot(hp, id, ROOT_NATIVE_STATIC);
             // puts("\t heap root native global");
             // putchar('G');
-            rootg++;
+            st->rootg++;
             break;
         }
         case 0x02 : {    // HPROF_GC_ROOT_JNI_LOCAL
             long long id;
             int threadSeq, depth;
-            id = readIdent(jf);
-            readUint(jf->fin, &threadSeq);
-            readUint(jf->fin, &depth);
-            hsize -= jf->identsz + 8;
+            id = dump_ident(cur, jf->identsz);
+            threadSeq = dump_u4(cur);
+            depth = dump_u4(cur);
             if (debug)
                 printf("0x%08lx root native local thread %d depth %d\n", id, threadSeq, depth);
-            ri = mkrinfo(jf->roots, id, 0, ROOT_NATIVE_LOCAL, "");
-            trbt_insert32(jf->roots, (long) id, ri);
+            addRoot(hp, id, ROOT_NATIVE_LOCAL);
             // puts("\t heap root native local");
             // putchar('L');
-            rootl++;
+            st->rootl++;
             break;
         }
         case 0x03 : {    // HPROF_GC_ROOT_JAVA_FRAME
             long long id;
             int threadSeq, depth;
-            id = readIdent(jf);
-            readUint(jf->fin, &threadSeq);
-            readUint(jf->fin, &depth);
-            hsize -= jf->identsz + 8;
+            id = dump_ident(cur, jf->identsz);
+            threadSeq = dump_u4(cur);
+            depth = dump_u4(cur);
             if (debug)
                 printf("0x%08lx root java local thread %d depth %d\n", id, threadSeq, depth);
-            ri = mkrinfo(jf->roots, id, 0, ROOT_JAVA_LOCAL, "");
-            trbt_insert32(jf->roots, (long) id, ri);
+            addRoot(hp, id, ROOT_JAVA_LOCAL);
             // puts("\t heap root native local");
             // puts("\t heap root java frame");
             // putchar('F');
-            frame++;
+            st->frame++;
             break;
         }
         case 0x04 : {    // HPROF_GC_ROOT_NATIVE_STACK
             long long id;
             int threadSeq;
-            id = readIdent(jf);
-            readUint(jf->fin, &threadSeq);
-            hsize -= jf->identsz + 4;
+            id = dump_ident(cur, jf->identsz);
+            threadSeq = dump_u4(cur);
             if (debug)
                 printf("0x%08lx root native stack \n", id);
-            ri = mkrinfo(jf->roots, id, 0, ROOT_NATIVE_STACK, "");
-            trbt_insert32(jf->roots, (long) id, ri);
+            addRoot(hp, id, ROOT_NATIVE_STACK);
             // puts("\t heap root native stack");
             // putchar('S');
-            stack++;
+            st->stack++;
             break;
         }
         case 0x05 : {    // HPROF_GC_ROOT_STICKY_CLASS
-            long long id = readIdent(jf);
-            hsize -= jf->identsz;
+            long long id = dump_ident(cur, jf->identsz);
             if (debug)
                 printf("0x%08lx root system class\n", id);
-            ri = mkrinfo(jf->roots, id, 0, ROOT_SYSTEM_CLASS, "");
-            trbt_insert32(jf->roots, (long) id, ri);
+            addRoot(hp, id, ROOT_SYSTEM_CLASS);
             // puts("\t heap root system class");
             // putchar('C');
-            sclass++;
+            st->sclass++;
             break;
         }
         case 0x06 : {    // HPROF_GC_ROOT_THREAD_BLOCK
             long long id;
             int threadSeq;
-            id = readIdent(jf);
-            readUint(jf->fin, &threadSeq);
-            hsize -= jf->identsz + 4;
+            id = dump_ident(cur, jf->identsz);
+            threadSeq = dump_u4(cur);
             if (debug)
                 printf("0x%08lx root thread block\n", id);
-            ri = mkrinfo(jf->roots, id, 0, ROOT_THREAD_BLOCK, "");
-            trbt_insert32(jf->roots, (long) id, ri);
+            addRoot(hp, id, ROOT_THREAD_BLOCK);
             // puts("\t heap root thread block");
             // putchar('T');
-            tblock++;
+            st->tblock++;
             break;
         }
         case 0x07 : {    // HPROF_GC_ROOT_MONITOR_USED
-            int *iptr;
-            long long id = readIdent(jf);
-            hsize -= jf->identsz;
+            long long id = dump_ident(cur, jf->identsz);
             if (debug)
                 printf("0x%08lx root busy monitor\n", id);
-            iptr = (int *) talloc(jf->roots, long long);
-            *iptr = id;
-            trbt_insert32(jf->roots, (long) id, iptr);
+            addRoot(hp, id, ROOT_MONITOR);
             // puts("\t heap root monitor ");
             // putchar('M');
-            monitor++;
+            st->monitor++;
             break;
         }
         case 0x20 : {    // HPROF_GC_CLASS_DUMP
-            hsize = readClass(jf, hsize);
-            cclass++;
+            struct hclass *hc;
+            const unsigned char *src;
+
+            if (hp->nclasses == hp->maxclasses) {
+                hp->maxclasses = hp->maxclasses ? 2 * hp->maxclasses : 256;
+                hp->classes = talloc_realloc(hp, hp->classes, struct hclass, hp->maxclasses);
+            }
+            hc = hp->classes + hp->nclasses;
+            hc->off = dump_tell(cur);
+            dump_mark(cur);
+            if (skipClass(jf, cur)) {
+                fprintf(stderr, "decodeHeap: bad value type in class dump at 0x%lx\n", (long) hc->off);
+                dump_unmark(cur);
+                dump_seek(cur, end);
+                st->cclass++;
+                break;
+            }
+            // keep a copy, the merge should not have to go back to the dump
+            hc->len = dump_tell(cur) - hc->off;
+            dump_seek(cur, hc->off);
+            if (NULL != (src = dump_bytes(cur, hc->len))) {
+                hc->data = talloc_memdup(hp, src, hc->len);
+                hp->nclasses++;
+            }
+            dump_unmark(cur);
+            st->cclass++;
             break;
         }
         case 0x21 : {    // HPROF_GC_INSTANCE_DUMP
             long long ide, classId;
-            unsigned int stackId, isz, cnt, fpos;
-            hobject *ho;
+            unsigned int stackId, isz;
+            struct orec *rec;
             cinfo *ci;
 
-            ide = readIdent(jf);
-            readUint(jf->fin, &stackId);
-            classId = readIdent(jf);
-            readUint(jf->fin, &isz);
-            hsize -= isz + 8 + jf->identsz + jf->identsz;
-            ci = (cinfo *) trbt_lookup32(jf->cTable, classId);
-            ci->count++;
-            if (debug)
-                printf("0x%x instance 0x%x %s\n", ide, classId, ci->name);
-            // fpos = ftell(jf->fin);
-            // cnt = countbytes(jf->fin, isz);
-            if (0 && classId == jf->javaLangString->ident) {
-                ho = makeObj(jf->hTable, H_INSTANCE, ide, classId);
-                ho->fpos = ftello(jf->fin);
-                resolveInstance(jf, ho);
-                printString(jf, ho);
-                talloc_free(ho);
-            }
-            if (50000 > ci->count || classId == jf->javaLangString->ident) {
-                ho = makeObj(jf->hTable, H_INSTANCE, ide, classId);
-                ho->fpos = ftello(jf->fin);
-                trbt_insert32(jf->hTable, ide, ho);
+            ide = dump_ident(cur, jf->identsz);
+            stackId = dump_u4(cur);
+            classId = dump_ident(cur, jf->identsz);
+            isz = dump_u4(cur);
+            st->inst++;
+            if (NULL == (ci = (cinfo *) idmap_lookup(jf->cTable, classId))) {
+                fprintf(stderr, "decodeHeap: instance 0x%llx of unknown class 0x%llx\n", ide, classId);
+                dump_skip(cur, isz);
+                break;
             }
+            if (debug)
+                printf("0x%llx instance 0x%llx %s\n", ide, classId, ci->name);
+            rec = addObj(hp, H_INSTANCE, ide, dump_tell(cur));
+            rec->cls = ci->cnum;
             // putchar('i');
-            fseek(jf->fin, isz, SEEK_CUR);
-            inst++;
+            if (jf->store) {
+                const unsigned char *src = dump_bytes(cur, isz);
+                if (src)
+                    rec->fpos = dump_append(jf->store, src, isz);
+            } else
+                dump_skip(cur, isz);
             break;
         }
         case 0x22 : {    // HPROF_GC_OBJ_ARRAY_DUMP
             // puts("\t heap object array");
             // putchar('o');
-            hsize = readArray(jf, hsize, 0);
-            oarr++;
+            if (readArray(jf, hp, cur, 0))
+                dump_seek(cur, end);
+            st->oarr++;
             break;
         }
         case 0x23 : {    // HPROF_GC_PRIM_ARRAY_DUMP
             // puts("\t heap prim array");
             // putchar('p');
-            hsize = readArray(jf, hsize, 1);
-            parr++;
+            if (readArray(jf, hp, cur, 1))
+                dump_seek(cur, end);
+            st->parr++;
             break;
         }
         default:
             fprintf(stderr, "readHeap: unknown heap type 0x%x\n", rtype);
-            fseek(jf->fin, hsize, SEEK_CUR);
-            hsize = 0;
+            dump_seek(cur, end);
             break;
-    }
-    }
-    puts("\nHeap Summary");
-    printf("\t%15s : %8d \n", "root thread", roott);
-    printf("\t%15s : %8d \n", "root global", rootg);
-    printf("\t%15s : %8d \n", "root local", rootl);
-    printf("\t%15s : %8d \n", "root frame", frame);
-    printf("\t%15s : %8d \n", "stack", stack);
-    printf("\t%15s : %8d \n", "system class", sclass);
-    printf("\t%15s : %8d \n", "thread block", tblock);
-    printf("\t%15s : %8d \n", "monitor", monitor);
-    printf("\t%15s : %8d \n", "class", cclass);
-    printf("\t%15s : %8d \n", "instance", inst);
-    printf("\t%15s : %8d \n", "object array", oarr);
-    printf("\t%15s : %8d \n", "primary array", parr);
-
-    // resolveClasses(jf);
-
-    puts("Class Summary");
-    printClass_r(jf->cTable->root);
-
-    if (jf->fclass) {
-        // cinfo *cdata = findClass(jf, "com/teramedica/web/actions/notification/TMNotificationListAction");
-        // cinfo *cdata = findClass(jf, "java/util/concurrent/ConcurrentHashMap$Segment");
-        if ('*' == jf->fclass[0]) {
-            resolveInstances(jf, jf->hTable->root);
-            printInstances(jf, jf->hTable->root);
-        } else {
-            cinfo *cdata = findClass(jf, jf->fclass);
-            if (cdata)
-                collectStats(jf, jf->hTable->root, (long) cdata->ident);
-            else 
-                printf("findclass: \'%s\' not found\n", jf->fclass);
         }
     }
-
-    // mg_assemble(jf);
 }
 
-Arc *
-arc_lookup(struct jdump *jf, cinfo *parent, cinfo *child)
+void
+decodeHeap(void *arg, int job)
 {
-    Arc * arc;
+    struct jdump *jf = (struct jdump *) arg;
+    hpart *hp = jf->parts[job];
+    struct dcursor cur;
 
-    if (!parent || !child) {
-        puts("[arc_lookup] parent || child is NULL");
-        return NULL;
-    }
-
-    for (arc = parent->children; arc; arc = arc->next_child) {
-        if (child == arc->child)
-            return arc;
-    }
-    return NULL;
+    if (hp->decoded)
+        return;
+    if (hp->data)
+        dump_memcursor(&cur, hp->data, hp->off, hp->len);
+    else
+        dump_cursor(jf->dump, &cur, hp->off, hp->len);
+    decodePart(jf, hp, &cur);
+    dump_release(&cur);
+    talloc_free(hp->data);
+    hp->data = NULL;
+    hp->decoded = 1;
 }
 
+/* apply what decodeHeap queued for one part to the dump tables */
 void
-arc_add(struct jdump *jf, hobject *hop, hobject *hoc, long count)
+mergeHeap(struct jdump *jf, hpart *hp)
 {
-    Arc * arc;
-    cinfo *parent, *child;
+    hstats *st = jf->hst;
+    struct dcursor cur;
+    long i;
 
-    parent = (cinfo *) trbt_lookup32(jf->cTable, (long) hop->classId);
-    child  = (cinfo *) trbt_lookup32(jf->cTable, (long) hoc->classId);
+    st->roott += hp->st.roott;      st->rootg += hp->st.rootg;
+    st->rootl += hp->st.rootl;      st->frame += hp->st.frame;
+    st->stack += hp->st.stack;      st->sclass += hp->st.sclass;
+    st->tblock += hp->st.tblock;    st->monitor += hp->st.monitor;
+    st->cclass += hp->st.cclass;    st->inst += hp->st.inst;
+    st->oarr += hp->st.oarr;        st->parr += hp->st.parr;
 
-    arc = arc_lookup(jf, parent, child);
-    if (arc) {
-        arc->count += count;
-        arc->child_size += hoc->size;
-        return;
+    for (i = 0; i < hp->nclasses; i++) {
+        dump_memcursor(&cur, hp->classes[i].data, hp->classes[i].off, hp->classes[i].len);
+        readClass(jf, &cur);
     }
 
-    arc = (Arc *) talloc(NULL, Arc);
-    arc->parent = parent;
-    arc->child = child;
-    arc->count = count;
-    arc->child_size = hoc->size;
-
-    if (parent != child) {
-        if (arcs_num == arcs_max) {
-            Arc **newarcs;
-            arcs_max += 10;
-            newarcs = (Arc **) talloc_size(NULL, sizeof(Arc *) * arcs_max);
-            memcpy(newarcs, arcs, arcs_num * sizeof(Arc *));
-            talloc_free(arcs);
-            arcs = newarcs;
-        }
-        arcs[arcs_num++] = arc;
+    for (i = 0; i < hp->nroots; i++) {
+        rinfo *ri = hp->roots + i;
+        idmap_insert(jf->roots, ri->ident, mkrinfo(jf->roots, ri->ident, 0, ri->rtype, ""));
     }
 
-    arc->next_child = parent->children;
-    parent->children = arc;
+    for (i = 0; i < hp->nobjs; i++) {
+        struct orec *rec = hp->objs + i;
 
-    arc->next_parent = child->parents;
-    child->parents = arc;
+        if (H_INSTANCE == rec->htype)
+            jf->classes[rec->cls]->count++;
+        else
+            rec->cls = arrayClass(jf, rec->htype, rec->cls)->cnum;
+    }
+    objtab_append(jf->objs, hp->objs, hp->nobjs);
 }
 
-void
-arc_init(cinfo *ci)
+/* queue a heap dump record or segment for readHeap */
+hpart *
+addHeap(struct jdump *jf, off_t off, unsigned int hsize)
 {
-    ci->child_size = ci->print_flag = 0;
-    ci->top_order = MG_DFN_NAN;
-    ci->cyc_num = 0;
-    ci->cyc_head = ci;
-    ci->cyc_next = NULL;
-    ci->parents = ci->children = NULL;
+    hpart *hp = talloc_zero(NULL, hpart);
+
+    hp->off = off;
+    hp->len = hsize;
+    if (jf->nparts == jf->maxparts) {
+        // the feed indexes jf->parts, let it run dry before it moves
+        if (jf->feed)
+            tpool_wait(jf->feed, 0);
+        jf->maxparts = jf->maxparts ? 2 * jf->maxparts : 16;
+        jf->parts = (hpart **) realloc(jf->parts, sizeof(hpart *) * jf->maxparts);
+    }
+    jf->parts[jf->nparts++] = hp;
+    return hp;
 }
 
-struct _dfstack {
-    cinfo *obj;
-    int cyctop;
-};
-typedef struct _dfstack dfstack;
-
-int dfn_depth = 0, dfn_maxdepth = 0, dfn_counter = MG_DFN_NAN;
-dfstack *dfn_stack = NULL;
-
-trbt_tree_t *cyctab, *topotab, *sizetab;
-int num_cycles = 0, num_objs;
-
-struct jdump *gtab;
-
-void
-mg_previsit(cinfo *ho)
+/* step over one heap sub-record, returns -1 on one it cannot size */
+static int
+skipSub(struct jdump *jf, struct dcursor *cur)
 {
-    ++dfn_depth;
+    unsigned int n;
+    int elsz;
 
-    if (dfn_depth >= dfn_maxdepth) {
-        dfn_maxdepth += 16;
-        dfn_stack = (dfstack *) talloc_realloc(NULL, dfn_stack, dfstack, dfn_maxdepth);
+    switch (dump_u1(cur)) {
+    case 0xff :                 // HPROF_GC_ROOT_UNKNOWN
+    case 0x05 :                 // HPROF_GC_ROOT_STICKY_CLASS
+    case 0x07 :                 // HPROF_GC_ROOT_MONITOR_USED
+        dump_skip(cur, jf->identsz);
+        break;
+    case 0x04 :                 // HPROF_GC_ROOT_NATIVE_STACK
+    case 0x06 :                 // HPROF_GC_ROOT_THREAD_BLOCK
+        dump_skip(cur, jf->identsz + 4);
+        break;
+    case 0x02 :                 // HPROF_GC_ROOT_JNI_LOCAL
+    case 0x03 :                 // HPROF_GC_ROOT_JAVA_FRAME
+    case 0x08 :                 // HPROF_GC_ROOT_THREAD_OBJ
+        dump_skip(cur, jf->identsz + 8);
+        break;
+    case 0x01 :                 // HPROF_GC_ROOT_JNI_GLOBAL
+        dump_skip(cur, 2 * jf->identsz);
+        break;
+    case 0x20 :                 // HPROF_GC_CLASS_DUMP
+        return skipClass(jf, cur);
+    case 0x21 :                 // HPROF_GC_INSTANCE_DUMP
+        dump_skip(cur, 2 * jf->identsz + 4);
+        n = dump_u4(cur);
+        dump_skip(cur, n);
+        break;
+    case 0x22 :                 // HPROF_GC_OBJ_ARRAY_DUMP
+        dump_skip(cur, jf->identsz + 4);
+        n = dump_u4(cur);
+        dump_skip(cur, (off_t) (n + 1) * jf->identsz);
+        break;
+    case 0x23 :                 // HPROF_GC_PRIM_ARRAY_DUMP
+        dump_skip(cur, jf->identsz + 4);
+        n = dump_u4(cur);
+        if (0 == (elsz = primSize(dump_u1(cur))))
+            return -1;
+        dump_skip(cur, (off_t) n * elsz);
+        break;
+    default:
+        return -1;
     }
-    dfn_stack[dfn_depth].obj = ho;
-    dfn_stack[dfn_depth].cyctop = dfn_depth;
-    ho->top_order = MG_DFN_BUSY;
+    return 0;
 }
 
-void
-mg_postvisit(cinfo *ho)
+/*
+   Queue [start, pos) of a record being split and hand it to the feed.
+   When the cursor holds on to the record, the part is decoded from a
+   copy, and no more than a few copies are left waiting at once.
+*/
+static void
+cutHeap(struct jdump *jf, struct dcursor *cur, off_t start, off_t pos)
 {
-    cinfo *memb;
+    hpart *hp = addHeap(jf, start, pos - start);
 
-    if (ho->cyc_head == ho) {
-        ++dfn_counter;
-        for (memb = ho;  ho;  ho = ho->cyc_next) {
-            memb->top_order = dfn_counter;
-        }
+    if (0 <= cur->mark) {
+        hp->data = (unsigned char *) talloc_memdup(hp, cur->buf + (start - cur->boff), pos - start);
+        dump_mark(cur);
     }
-    --dfn_depth;
+    tpool_post(jf->feed, jf->nparts);
+    if (hp->data)
+        tpool_wait(jf->feed, 2 * jf->nthreads);
 }
 
+/*
+   Queue a heap record for readHeap in parts that start on sub-record
+   boundaries, so it is decoded by all the workers rather than one.  Only
+   the sub-record headers are read to find the boundaries, the bodies
+   are stepped over, and each part is decoded on the feed as soon as its
+   end is found, while the scan goes on.  From a sub-record it cannot
+   size on, the rest goes in one part, for decodePart to report.
+
+   Only a HPROF_HEAP_DUMP record of a plain dump is split, segments are
+   many already.  A gzip'd record or segment has to be inflated by this
+   cursor to be stepped over, so its parts are copied as they go by and
+   the workers decode the copies rather than inflate it again, or with
+   one thread it is decoded right from the cursor.
+*/
 void
-find_cycle(cinfo *ho)
+splitHeap(struct jdump *jf, struct dcursor *cur, off_t off, unsigned int hsize)
 {
-    cinfo *head = NULL;
-    int cycle_top;
-
-    for (cycle_top = dfn_depth;  cycle_top > 0;  --cycle_top) {
-        head = dfn_stack[cycle_top].obj;
-        if (ho == head)  break;
-        if (ho->cyc_head != ho && ho->cyc_head != head)
-            break;
-    }
-    if (cycle_top <= 0) {
-        fprintf(stderr, "[find_cycle] cannot find head of cycle\n");
+    off_t end = off + hsize, start = off, pos;
+    off_t chunk = hsize / (4 * (off_t) jf->nthreads);
+    int copy = NULL != jf->dump->zi;
+    hpart *hp;
+    int n;
+
+    if (1 == jf->nthreads || (!copy && hsize < 2 * HEAP_CHUNK)) {
+        hp = addHeap(jf, off, hsize);
+        if (copy) {             // on one thread, decode it as it goes by
+            decodePart(jf, hp, cur);
+            hp->decoded = 1;
+        }
         return;
     }
-
-    if (cycle_top != dfn_depth) {
-        cinfo *tail;
-        int index;
-        for (tail = head;  tail->cyc_next;  tail = tail->cyc_next)      // find tail
-            ;
-        if (head->cyc_head != head)
-            head = head->cyc_head;
-        for (index = cycle_top + 1; index <= dfn_depth; ++index) {
-            ho = dfn_stack[index].obj;
-            if (ho->cyc_head == ho) {
-                tail->cyc_next = ho;
-                ho->cyc_head = head;
-                for (tail = ho;  tail->cyc_next;  tail = tail->cyc_next)
-                    tail->cyc_next->cyc_head = head;
-            } else if (ho->cyc_head != head) {
-                fprintf(stderr, "[find_cycle] captured, but not to head\n");
-                return;
-            }
+    if (copy || chunk < HEAP_CHUNK)
+        chunk = HEAP_CHUNK;     // copies wait for a worker, keep them small
+    // make room for the parts up front, growing jf->parts drains the feed
+    n = jf->nparts + hsize / chunk + 1;
+    if (n > jf->maxparts) {
+        if (jf->feed)
+            tpool_wait(jf->feed, 0);
+        jf->maxparts = n;
+        jf->parts = (hpart **) realloc(jf->parts, sizeof(hpart *) * jf->maxparts);
+    }
+    if (NULL == jf->feed)
+        jf->feed = tpool_start(jf->nthreads, decodeHeap, jf);
+
+    if (copy)
+        dump_mark(cur);
+    while ((pos = dump_tell(cur)) < end && !cur->err) {
+        if (pos - start >= chunk) {
+            cutHeap(jf, cur, start, pos);
+            start = pos;
         }
+        if (skipSub(jf, cur))
+            break;
     }
+    if (pos != end)
+        dump_unmark(cur);       // the rest is read from the dump
+    cutHeap(jf, cur, start, end);
+    dump_unmark(cur);
 }
 
-#define IS_NUMBERED(x)  MG_DFN_NAN != (x)->top_order && MG_DFN_BUSY != (x)->top_order
-#define IS_BUSY(x)      MG_DFN_NAN != (x)->top_order
-
 void
-mg_dfn(cinfo *ho)
+heapSummary(struct jdump *jf)
 {
-    Arc *arc;
+    hstats *st = jf->hst;
 
-    if (IS_NUMBERED(ho))  return;
+    puts("\nHeap Summary");
+    printf("\t%15s : %8d \n", "root thread", st->roott);
+    printf("\t%15s : %8d \n", "root global", st->rootg);
+    printf("\t%15s : %8d \n", "root local", st->rootl);
+    printf("\t%15s : %8d \n", "root frame", st->frame);
+    printf("\t%15s : %8d \n", "stack", st->stack);
+    printf("\t%15s : %8d \n", "system class", st->sclass);
+    printf("\t%15s : %8d \n", "thread block", st->tblock);
+    printf("\t%15s : %8d \n", "monitor", st->monitor);
+    printf("\t%15s : %8d \n", "class", st->cclass);
+    printf("\t%15s : %8d \n", "instance", st->inst);
+    printf("\t%15s : %8d \n", "object array", st->oarr);
+    printf("\t%15s : %8d \n", "primary array", st->parr);
 
-    if (IS_BUSY(ho)) {          // already busy, we found a cycle
-        find_cycle(ho);
-        return;
-    }
-    mg_previsit(ho);
-    for (arc = ho->children;  arc;  arc = arc->next_child) {
-        mg_dfn(arc->child);
+    // resolveClasses(jf);
+
+    puts("Class Summary");
+    printClasses(jf);
+
+    if (jf->fclass || jf->referrers || jf->paths || jf->dominators || jf->classgraph)
+        buildGraph(jf);
+    if (jf->dominators)
+        buildDominators(jf);
+    if (jf->fclass) {
+        struct walk w;
+
+        walkStart(jf, &w);
+        // cinfo *cdata = findClass(jf, "com/teramedica/web/actions/notification/TMNotificationListAction");
+        // cinfo *cdata = findClass(jf, "java/util/concurrent/ConcurrentHashMap$Segment");
+        if ('*' == jf->fclass[0]) {
+            resolveInstances(jf, &w);
+            printInstances(jf, &w);
+        } else {
+            char *sel = talloc_zero_array(NULL, char, jf->nclasses);
+            if (selectClasses(jf, jf->fclass, sel))
+                collectStats(jf, &w, sel);
+            else 
+                printf("findclass: \'%s\' not found\n", jf->fclass);
+            talloc_free(sel);
+        }
+        walkEnd(&w);
     }
-    mg_postvisit(ho);
+    if (jf->referrers)
+        printReferrers(jf, jf->referrers);
+    if (jf->paths)
+        printPaths(jf, jf->paths);
+    if (jf->dominators)
+        printDominators(jf);
+
+    if (jf->classgraph)
+        mg_assemble(jf);
 }
 
+/*
+   Decode the queued heap parts, a HPROF_HEAP_DUMP record or all the
+   HPROF_HEAP_DUMP_SEGMENTs of one dump, in parallel, then merge them in
+   file order and print the summary.
+*/
 void
-mg_dfn_lup(long long *idp, struct jdump *jf)
+readHeap(struct jdump *jf)
 {
-    hobject *ho = (hobject *) trbt_lookup32(jf->hTable, (long) *idp);
-    cinfo *ci;
+    int i;
 
-    if (NULL == ho) {
-        printf("WARNING: mg_dfn_lup: invalid root lookup 0x%08x\n", *idp);
+    if (0 == jf->nparts)
         return;
-    }
 
-    ci = (cinfo *) trbt_lookup32(jf->cTable, (long) ho->classId);
+    jf->javaLangString = findClass(jf, "java/lang/String");
 
-    if (NULL == ci) {
-        printf("WARNING: mg_dfn_lup: invalid ident lookup 0x%08x\n", *idp, ho->classId);
-        return;
+    // a streamed dump was decoded as it went by, and a split record as it was split
+    if (jf->feed) {
+        tpool_finish(jf->feed);
+        jf->feed = NULL;
     }
+    if (NULL == jf->store)
+        tpool_run(jf->nthreads, jf->nparts, decodeHeap, jf);
 
-    mg_dfn(ci);
+    memset(jf->hst, 0, sizeof(hstats));
+    for (i = 0; i < jf->nparts; i++) {
+        mergeHeap(jf, jf->parts[i]);
+        talloc_free(jf->parts[i]);
+    }
+    jf->nparts = 0;
+    objtab_index(jf->objs);
+    if (jf->store) {
+        dump_sync(jf->store);
+        dump_cursor(jf->store, &jf->rcur, 0, -1);
+    }
+
+    heapSummary(jf);
 }
 
 void
-cyc_iter(cinfo *ci, struct jdump *jf)
+arc_init(cinfo *ci)
 {
-    cinfo *cycobj, *memb, *nci;
-    char *cname;
-    static int elemClassId = 16;
+    ci->child_size = 0;
+    ci->top_order = MG_DFN_NAN;
+    ci->cyc_num = 0;
+    ci->cyc_head = ci;
+    ci->cyc_next = NULL;
+    ci->parents = ci->children = NULL;
+}
 
-    if (!(ci->cyc_head == ci && ci->cyc_next))
-        return;
+/* the arc from class number parent to class number child, made on first use */
+static Arc *
+arc_get(struct jdump *jf, unsigned int parent, unsigned int child)
+{
+    uint64_t key = (uint64_t) parent << 32 | child;
+    Arc *arc;
 
-    cname = talloc_zero_array(gtab->sbTable, char, 20);
-    sprintf(cname, "<Cycle %d>", ++num_cycles);
-    nci = mkcinfo(jf->cTable, fakeClass++, elemClassId, cname);
-    trbt_insert32(jf->cTable, fakeClass, nci);
-    trbt_insert32(jf->rcTable, hashKey(cname), nci);
+    if (NULL != (arc = (Arc *) idmap_lookup(jf->arcs, key)))
+        return arc;
+    arc = (Arc *) arena_zalloc(jf->arcHeap, sizeof(Arc));
+    arc->parent = jf->classes[parent];
+    arc->child = jf->classes[child];
 
-    nci->top_order = MG_DFN_NAN;
-    nci->cyc_num = num_cycles;
-    nci->cyc_head = cycobj;
-    nci->cyc_next = ci;
-    for (memb = ci;  memb;  memb->cyc_next) {
-        memb->cyc_num = num_cycles;
-        memb->cyc_head = cycobj;
-    }
-    trbt_insert32(cyctab, num_cycles, cycobj);
-}
+    arc->next_child = arc->parent->children;
+    arc->parent->children = arc;
 
-void
-topo_sort(cinfo *ci)
-{
-    trbt_insert32(topotab, ci->top_order, ci);
+    arc->next_parent = arc->child->parents;
+    arc->child->parents = arc;
+
+    idmap_insert(jf->arcs, key, arc);
+    jf->narcs++;
+    return arc;
 }
 
+/*
+   Fold jf->graph into the class graph in one pass over the references.
+   An arc from class p to class c counts the references from objects of
+   p, or from the statics of p, to objects of c, and the bytes of the
+   objects referenced.  The references of one object are in field order,
+   so runs of them to the same class cost one lookup.
+*/
 void
-size_sort(cinfo *ci)
+buildClassGraph(struct jdump *jf)
 {
-    trbt_insert32(sizetab, ci->size + ci->child_size, ci);
-}
+    struct refgraph *g = jf->graph;
+    size_t nobjs = jf->objs->n;
+    uint32_t u, v;
+    unsigned int i;
+    uint64_t e;
 
-cinfo *old_head = NULL;
-long print_size = 0;
+    for (i = 0; i < jf->nclasses; i++) {
+        arc_init(jf->classes[i]);
+        jf->classes[i]->size = jf->classes[i]->nobjs = 0;
+    }
+    talloc_free(jf->arcs);
+    jf->arcs = idmap_create(NULL, 0);
+    jf->arcHeap = arena_create(jf->arcs, 0);
+    jf->narcs = 0;
 
-void
-prop_flags(cinfo *ho)
-{
-    if (ho->cyc_head != old_head) {
-        cinfo *head;
-
-        head = old_head = ho->cyc_head;
-        head = ho->cyc_head;
-        if (ho == head) {
-            Arc *arc;
-            ho->print_flag = 0;
-            for (arc = ho->parents;  arc;  arc = arc->next_parent) {
-                if (ho == arc->parent)
-                    continue;
-                ho->print_flag |= arc->parent->print_flag;
-            }
-        } else {
-            Arc *arc;
-            cinfo *memb;
-            head->print_flag = 0;
-            for (memb = head->cyc_next;  memb;  memb = memb->cyc_next)
-            for (arc = memb->parents;  arc;  arc = arc->next_parent) {
-                if (arc->parent->cyc_head == head)
-                    continue;
-                head->print_flag |= arc->parent->print_flag;
-            }
-            for (memb = head;  memb;  memb = memb->cyc_next)
-                memb->print_flag = head->print_flag;
+    for (u = 0; u < g->n; u++) {
+        unsigned int pc = u < nobjs ? jf->objs->recs[u].cls : u - nobjs;
+        Arc *arc = NULL;
+
+        if (u < nobjs) {
+            jf->classes[pc]->size += objSize(jf, u);
+            jf->classes[pc]->nobjs++;
+        }
+        for (e = g->first[u]; e < g->first[u + 1]; e++) {
+            unsigned int cc;
+
+            if ((v = g->to[e]) >= nobjs)
+                continue;       // a class object, it has no bytes of its own
+            cc = jf->objs->recs[v].cls;
+            if (NULL == arc || cc != arc->child->cnum)
+                arc = arc_get(jf, pc, cc);
+            arc->count++;
+            arc->bytes += objSize(jf, v);
         }
     }
-    if (!ho->print_flag)
-        ho->print_flag = 1;
-    print_size += ho->size;
+    if (debug)
+        printf("class graph: %zu arcs\n", jf->narcs);
 }
 
-void
-prop_size(cinfo *ho)
-{
+/* a class being searched by findCycles, and the next of its arcs to follow */
+struct sccframe {
+    cinfo *ci;
     Arc *arc;
-    if (0 == ho->size)
-        return;
+};
 
-    for (arc = ho->children;  arc;  arc = arc->next_child) {
-        cinfo *child = arc->child;
-        if (arc->count == 0 || arc->child == ho)
+/* pop the component headed by ci off the stack, collapse it if it is a cycle */
+static void
+finishComponent(struct jdump *jf, cinfo **stack, unsigned int *top, cinfo *ci)
+{
+    cinfo *head = ci, *memb;
+    unsigned int k = *top;
+
+    while (stack[--k] != ci)
+        ;
+    if (*top - k > 1) {
+        char cname[32];
+        int n;
+
+        head = (cinfo *) arena_zalloc(jf->arcHeap, sizeof(cinfo));
+        head->cyc_num = ++jf->ncycles;
+        head->cnum = jf->nclasses + head->cyc_num - 1;
+        n = snprintf(cname, sizeof(cname), "<Cycle %d>", head->cyc_num);
+        head->name = strpool_str(jf->names, strpool_intern(jf->names, cname, n));
+        head->cyc_head = head;
+    }
+    head->top_order = ++jf->ntopo;
+    jf->topo[jf->ntopo - 1] = head;
+    while (*top > k) {
+        memb = stack[--*top];
+        memb->top_order = head->top_order;
+        if (head == memb)
             continue;
-        if (arc->child->cyc_head != arc->child)  {
-            if (ho->cyc_num == arc->child->cyc_num)
-                continue;
-            if (ho->top_order <= arc->child->top_order)
-                fprintf(stderr, "[prop_size] topo order botched\n");
-            child = child->cyc_head;
-        } else {
-            if (ho->top_order <= child->top_order) {
-                fprintf(stderr, "[prop_size] topo order botched\n");
-                continue;
-            }
-        }
-        arc->size = child->size;
-        arc->child_size = child->child_size; 
-        ho->child_size += arc->size + arc->child_size;
-
-        if (ho->cyc_head != ho)
-            ho->cyc_head->child_size += arc->size + arc->child_size;
+        memb->cyc_num = head->cyc_num;
+        memb->cyc_head = head;
+        memb->cyc_next = head->cyc_next;
+        head->cyc_next = memb;
+        head->size += memb->size;
+        head->nobjs += memb->nobjs;
     }
 }
 
+/*
+   Collapse the cycles of the class graph into "<Cycle N>" nodes.  This
+   is Tarjan's strongly connected components, with the recursion kept
+   in frames, so every class and arc is looked at once.  A component is
+   finished after every component it references, so top_order numbers
+   them children first and jf->topo lists their heads in that order.
+*/
 void
-arc_iter(void (*func)(), trbt_node_t *cnode, struct jdump *jf)
+findCycles(struct jdump *jf)
 {
-    if (NULL == cnode)
-        return;
-    arc_iter(func, cnode->left, jf);
-    (*func)((cinfo *) cnode->data, jf);
-    arc_iter(func, cnode->right, jf);
-}
+    unsigned int n = jf->nclasses, i, counter = 0, sp, top = 0;
+    uint32_t *dfn = talloc_zero_array(NULL, uint32_t, n + 1);
+    uint32_t *low = talloc_array(dfn, uint32_t, n + 1);
+    cinfo **stack = talloc_array(dfn, cinfo *, n + 1);
+    struct sccframe *frames = talloc_array(dfn, struct sccframe, n + 1);
 
-void
-arc_rev_iter(void (*func)(), trbt_node_t *cnode)
-{
-    if (NULL == cnode)
-        return;
-    arc_iter(func, cnode->right, NULL);
-    (*func)((cinfo *) cnode->data);
-    arc_iter(func, cnode->left, NULL);
-}
+    jf->topo = talloc_array(jf->arcs, cinfo *, n + 1);
+    jf->ntopo = jf->ncycles = 0;
 
-void
-cycle_link(struct jdump *jf)
-{
-    num_cycles = 0;
-    arc_iter(&cyc_iter, jf->hTable->root, jf);
+    for (i = 0; i < n; i++) {
+        cinfo *ci = jf->classes[i];
+
+        if (dfn[i])
+            continue;
+        dfn[i] = low[i] = ++counter;
+        stack[top++] = ci;
+        frames[0].ci = ci;
+        frames[0].arc = ci->children;
+        sp = 1;
+        while (sp) {
+            struct sccframe *f = frames + sp - 1;
+            unsigned int c = f->ci->cnum;
+
+            if (f->arc) {
+                cinfo *child = f->arc->child;
+                unsigned int d = child->cnum;
+
+                f->arc = f->arc->next_child;
+                if (0 == dfn[d]) {
+                    dfn[d] = low[d] = ++counter;
+                    stack[top++] = child;
+                    frames[sp].ci = child;
+                    frames[sp++].arc = child->children;
+                } else if (MG_DFN_NAN == child->top_order && dfn[d] < low[c]) {
+                    low[c] = dfn[d];        // still on the stack, in this component
+                }
+                continue;
+            }
+            if (low[c] == dfn[c])
+                finishComponent(jf, stack, &top, f->ci);
+            if (--sp && low[c] < low[frames[sp - 1].ci->cnum])
+                low[frames[sp - 1].ci->cnum] = low[c];
+        }
+    }
+    talloc_free(dfn);
+    if (debug)
+        printf("class graph: %u components %u cycles\n", jf->ntopo, jf->ncycles);
 }
 
+/*
+   Hand the bytes of each component, and of what is below it, up to the
+   classes that reference it, in proportion to the bytes they reference,
+   as gprof does with time.  One sweep over the components, children
+   first, so a component is complete before its parents take their
+   share.  Arcs within a component carry nothing.
+*/
 void
-cycle_size(cinfo *ho)
+propSizes(struct jdump *jf)
 {
-    cinfo *memb;              // size of the cycle is the size of all of it's members
-
-    for (memb = ho->cyc_next;  memb;  memb = memb->cyc_next)
-        ho->size += memb->size;
-}
+    uint64_t *in = talloc_zero_array(NULL, uint64_t, jf->ntopo + 1);
+    unsigned int i, t;
+    Arc *arc;
 
-int
-cmp_arc(Arc *left, Arc *right)
-{
-    int size;
+    // bytes referenced from outside each component
+    for (i = 0; i < jf->nclasses; i++) {
+        cinfo *ci = jf->classes[i];
 
-    if (left->parent == left->child)    return -1;
-    if (right->parent == right->child)  return 1;
-    if (left->parent->cyc_num && left->child->cyc_num && left->parent->cyc_num == left->child->cyc_num) {
-        if (right->parent->cyc_num && right->child->cyc_num && right->parent->cyc_num == right->child->cyc_num)
-            return left->count - right->count;
-        else 
-            return -1;
+        for (arc = ci->parents; arc; arc = arc->next_parent)
+            if (arc->parent->cyc_head != ci->cyc_head)
+                in[ci->top_order - 1] += arc->bytes;
     }
-    if (right->parent->cyc_num && right->child->cyc_num && right->parent->cyc_num == right->child->cyc_num) 
-        return 1;
 
-    size = left->size - right->size;
+    for (t = 0; t < jf->ntopo; t++) {
+        cinfo *head = jf->topo[t], *memb;
 
-    return size != 0 ? size : left->count - right->count;
-    
+        for (memb = head->cyc_num ? head->cyc_next : head; memb; memb = memb->cyc_next) {
+            for (arc = memb->children; arc; arc = arc->next_child) {
+                cinfo *child = arc->child->cyc_head;
+                double share;
+
+                if (child == head || 0 == in[child->top_order - 1])
+                    continue;
+                share = (double) arc->bytes / in[child->top_order - 1];
+                arc->size = share * child->size;
+                arc->child_size = share * child->child_size;
+                memb->child_size += arc->size + arc->child_size;
+                if (head != memb)
+                    head->child_size += arc->size + arc->child_size;
+            }
+        }
+    }
+    talloc_free(in);
 }
 
-void
-sort_parents(cinfo *ho)
+/* arcs by the bytes they carry, then references, then name, largest first */
+static int
+cmp_arc(const void *l, const void *r)
 {
-    Arc *arc, *detached, sorted, *prev;
-
-    sorted.next_parent = NULL;
-    for (arc = ho->parents;  arc;  arc = detached) {
-        detached = arc->next_parent;
-        for (prev = &sorted; prev->next_parent; prev = prev->next_parent)
-            if (0 >= cmp_arc(arc, prev->next_parent))
-                break;
-        arc->next_parent = prev->next_parent;
-        prev->next_parent = arc;
-    }
-    ho->parents = sorted.next_parent;
+    const Arc *left = *(Arc * const *) l, *right = *(Arc * const *) r;
+
+    if (left->size + left->child_size != right->size + right->child_size)
+        return left->size + left->child_size < right->size + right->child_size ? 1 : -1;
+    if (left->bytes != right->bytes)
+        return left->bytes < right->bytes ? 1 : -1;
+    if (left->count != right->count)
+        return left->count < right->count ? 1 : -1;
+    return left->child->cnum != right->child->cnum ? (left->child->cnum < right->child->cnum ? -1 : 1)
+        : (left->parent->cnum < right->parent->cnum ? -1 : left->parent->cnum > right->parent->cnum);
 }
 
-void
-sort_children(cinfo *ho)
+/* classes and cycles by their bytes and the bytes below them, largest first */
+static int
+cmp_class(const void *l, const void *r)
 {
-    Arc *arc, *detached, sorted, *prev;
+    const cinfo *left = *(cinfo * const *) l, *right = *(cinfo * const *) r;
 
-    sorted.next_child = NULL;
-    for (arc = ho->children;  arc;  arc = detached) {
-        detached = arc->next_child;
-        for (prev = &sorted; prev->next_child; prev = prev->next_child)
-            if (0 <= cmp_arc(arc, prev->next_child))
-                break;
-        arc->next_child = prev->next_child;
-        prev->next_child = arc;
-    }
-    ho->children = sorted.next_child;
+    if (left->size + left->child_size != right->size + right->child_size)
+        return left->size + left->child_size < right->size + right->child_size ? 1 : -1;
+    return left->cnum < right->cnum ? -1 : left->cnum > right->cnum;
 }
 
-void
-print_name(cinfo *ci)
+#define IS_CYCLE(ci)    ((ci)->cyc_num && (ci)->cyc_head == (ci))
+
+/*
+   The parent or child arcs of a class, or those into or out of a cycle
+   from outside it, sorted by cmp_arc, *n of them.
+*/
+static Arc **
+sort_arcs(TALLOC_CTX *ctx, cinfo *ho, int parents, size_t *n)
 {
-#ifdef notdef
-    if (H_CYCLE == ho->htype) {
-        printf("Cycle <%d>\n", ho->cyc_num);
-        return;
+    cinfo *memb, *first = IS_CYCLE(ho) ? ho->cyc_next : ho;
+    Arc **sorted = NULL, *arc;
+    size_t k;
+    int pass;
+
+    // count, then fill
+    for (pass = 0; pass < 2; pass++) {
+        k = 0;
+        for (memb = first; memb; memb = IS_CYCLE(ho) ? memb->cyc_next : NULL) {
+            for (arc = parents ? memb->parents : memb->children; arc;
+                    arc = parents ? arc->next_parent : arc->next_child) {
+                if (IS_CYCLE(ho) && arc->parent->cyc_head == arc->child->cyc_head)
+                    continue;
+                if (sorted)
+                    sorted[k] = arc;
+                k++;
+            }
+        }
+        if (NULL == sorted)
+            sorted = talloc_array(ctx, Arc *, k + 1);
     }
-
-    cinfo *ci = (cinfo *) trbt_lookup32(gtab->cTable, ho->ident);
-    if (ci)
-        printf ("%s\n", ci->name);
-    else
-        printf ("[%d] Unknown\n", ho->ident);
-#endif
-    printf (" %s\n", ci->name);
+    qsort(sorted, k, sizeof(Arc *), cmp_arc);
+    *n = k;
+    return sorted;
 }
 
-void
-print_parents(cinfo *ho)
+static void
+print_name(cinfo *ci)
 {
-    Arc *arc;
-    if (!ho->parents)
-        return;
-    sort_parents(ho);
-    for (arc = ho->parents; arc; arc->next_parent) {
-        if (ho == arc->parent || (ho->cyc_num && arc->parent->cyc_num == ho->cyc_num))
-            printf("%6.6s %5.5s %7d %7d %7d/%7d      ",
-                "", "", arc->size, arc->child_size, arc->count, 0);
-        else
-            printf("%6.6s %5.5s %7d %7d %7d/%7d      ",
-                "", "", arc->size, arc->child_size, arc->count, 0);
-        print_name(ho);
-    }
+    if (ci->cyc_num && !IS_CYCLE(ci))
+        printf("%s <cycle %d> [%d]\n", ci->name, ci->cyc_num, ci->index);
+    else
+        printf("%s [%d]\n", ci->name, ci->index);
 }
 
 void
-print_children(cinfo *ho)
+print_arcs(cinfo *ho, int parents)
 {
-    Arc *arc;
-    if (!ho->children)
-        return;
-    sort_children(ho);
-    for (arc = ho->children; arc; arc->next_child) {
-        if (ho == arc->child || (ho->cyc_num && arc->child->cyc_num == ho->cyc_num))
-            printf("%6.6s %5.5s %7d %7d %7d/%7d      ",
-                "", "", arc->size, arc->child_size, arc->count, 0);
-        else
-            printf("%6.6s %5.5s %7d %7d %7d/%7d      ",
-                "", "", arc->size, arc->child_size, arc->count, 0);
-        print_name(ho);
+    Arc **sorted;
+    size_t i, n;
+
+    sorted = sort_arcs(NULL, ho, parents, &n);
+    for (i = 0; i < n; i++) {
+        printf("%6s %14ld %14ld %10s %10ld      ", "",
+            sorted[i]->size, sorted[i]->child_size, "", sorted[i]->count);
+        print_name(parents ? sorted[i]->parent : sorted[i]->child);
     }
+    talloc_free(sorted);
 }
 
+/*
+   Print the class graph in the style of gprof.  A block for each class,
+   and each cycle of classes, largest first: above it, the classes that
+   reference it and the share of its bytes, and of the bytes below it,
+   that each takes; below it, what it takes from the classes it
+   references.  A cycle's block lists its members.
+*/
 void
-mg_print(cinfo *ho)
+mg_print(struct jdump *jf)
 {
-    char buf[20];
-    ho->index = num_objs++;
-    sprintf(buf, "[%d]", ho->index);
-
-    // if (H_CYCLE == ho->htype) {
-    // } else {
-        print_parents(ho);
-        printf("%-6.6s %5.1f %7.2f %7.2f",
-            buf, 100 * (ho->size + ho->child_size) / print_size, ho->size, ho->child_size);
+    cinfo **order = talloc_array(NULL, cinfo *, jf->nclasses + jf->ncycles + 1);
+    unsigned int i, n = 0;
+
+    for (i = 0; i < jf->nclasses; i++) {
+        cinfo *ci = jf->classes[i];
+
+        if (ci->nobjs || ci->parents || ci->children)
+            order[n++] = ci;
+    }
+    for (i = 0; i < jf->ntopo; i++)
+        if (IS_CYCLE(jf->topo[i]))
+            order[n++] = jf->topo[i];
+    qsort(order, n, sizeof(cinfo *), cmp_class);
+    for (i = 0; i < n; i++)
+        order[i]->index = i;
+
+    printf("\nClass Graph, %u classes %zu arcs %u cycles\n", n - jf->ncycles, jf->narcs, jf->ncycles);
+    printf("%-6s %14s %14s %10s %10s      %s\n", "index", "bytes", "below", "objects", "refs", "class");
+    for (i = 0; i < n; i++) {
+        cinfo *ho = order[i], *memb;
+        char buf[20];
+
+        puts("-----------------------------------------------");
+        print_arcs(ho, 1);
+        snprintf(buf, sizeof(buf), "[%d]", ho->index);
+        printf("%-6s %14lu %14lu %10lu %10s      ", buf, ho->size, ho->child_size, ho->nobjs, "");
         print_name(ho);
-        print_children(ho);
-    // }
+        if (IS_CYCLE(ho)) {
+            for (memb = ho->cyc_next; memb; memb = memb->cyc_next) {
+                printf("%6s %14lu %14lu %10lu %10s      ", "", memb->size, memb->child_size, memb->nobjs, "");
+                print_name(memb);
+            }
+        } else {
+            print_arcs(ho, 0);
+        }
+    }
+    talloc_free(order);
 }
 
 void 
 mg_assemble(struct jdump *jf)
 {
-    arc_iter(&arc_init, jf->cTable->root, NULL);              // initialize
-    arc_iter(&mg_dfn_lup, jf->roots->root, jf);               // depth first numbering
-
-    cyctab = trbt_create(NULL, 0);
-
-    cycle_link(jf);                                     // link nodes on the same cycle
-
-    topotab = trbt_create(NULL, 0);
-    arc_iter(&topo_sort, jf->roots->root, NULL);             // topo sort the objs
-    arc_rev_iter(&prop_flags, topotab->root);           // prop flags to children
-
-    arc_iter(&cycle_size, cyctab->root, NULL);
-
-    arc_iter(&prop_size, topotab->root, NULL);                // prop size to children
-    talloc_free(topotab);
-
-    sizetab = trbt_create(NULL, 0);                     // size sort regular objs and the cycles
-    arc_iter(&size_sort, jf->roots->root, NULL);
-    arc_iter(&size_sort, cyctab->root, NULL);
-    talloc_free(cyctab);
-
-    arc_iter(&mg_print, sizetab->root, NULL);
+    buildClassGraph(jf);
+    findCycles(jf);
+    propSizes(jf);
+    mg_print(jf);
 }
@@ -0,0 +1,117 @@
+/*
+   compressed sparse row graph of references between heap objects
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "refgraph.h"
+
+struct refgraph *
+refgraph_create(TALLOC_CTX *memctx, size_t n)
+{
+    struct refgraph *g = talloc_zero(memctx, struct refgraph);
+
+    if (NULL == g || NULL == (g->first = talloc_zero_array(g, uint64_t, n + 1))) {
+        fprintf(stderr, "refgraph: cannot allocate a graph of %zu nodes\n", n);
+        exit(1);
+    }
+    g->n = n;
+    return g;
+}
+
+void
+refrun_start(struct refrun *r, uint32_t lo, uint32_t hi)
+{
+    memset(r, 0, sizeof(struct refrun));
+    r->lo = r->next = lo;
+    r->hi = hi;
+}
+
+void
+refrun_grow(struct refrun *r)
+{
+    r->max = r->max ? 2 * r->max : 4096;
+    if (NULL == (r->to = (uint32_t *) realloc(r->to, sizeof(uint32_t) * r->max))) {
+        fprintf(stderr, "refgraph: cannot allocate %zu edges\n", r->max);
+        exit(1);
+    }
+}
+
+void
+refgraph_join(struct refgraph *g, struct refrun *runs, int nruns)
+{
+    uint64_t base = 0;
+    uint32_t i;
+    int k;
+
+    for (k = 0; k < nruns; k++)
+        base += runs[k].n;
+    g->nedges = base;
+    g->to = talloc_array(g, uint32_t, base ? base : 1);
+    if (NULL == g->to) {
+        fprintf(stderr, "refgraph: cannot allocate %llu edges\n", (unsigned long long) base);
+        exit(1);
+    }
+
+    // the runs numbered their edges from 0, shift them to where they land
+    base = 0;
+    for (k = 0; k < nruns; k++) {
+        struct refrun *r = runs + k;
+
+        for (i = r->next; i < r->hi; i++)
+            g->first[i] = r->n;
+        for (i = r->lo; i < r->hi; i++)
+            g->first[i] += base;
+        if (r->n)
+            memcpy(g->to + base, r->to, sizeof(uint32_t) * r->n);
+        base += r->n;
+        free(r->to);
+        r->to = NULL;
+    }
+    g->first[g->n] = base;
+}
+
+struct refgraph *
+refgraph_reverse(TALLOC_CTX *memctx, const struct refgraph *g)
+{
+    struct refgraph *rg = refgraph_create(memctx, g->n);
+    uint64_t e, *fill;
+    size_t i;
+
+    rg->nedges = g->nedges;
+    rg->to = talloc_array(rg, uint32_t, g->nedges ? g->nedges : 1);
+    fill = talloc_array(rg, uint64_t, g->n + 1);
+    if (NULL == rg->to || NULL == fill) {
+        fprintf(stderr, "refgraph: cannot allocate %llu reverse edges\n", (unsigned long long) g->nedges);
+        exit(1);
+    }
+
+    // count the edges into each node, then place them going through
+    // the nodes they come from in order
+    for (e = 0; e < g->nedges; e++)
+        rg->first[g->to[e] + 1]++;
+    for (i = 0; i < g->n; i++)
+        rg->first[i + 1] += rg->first[i];
+    memcpy(fill, rg->first, sizeof(uint64_t) * (g->n + 1));
+    for (i = 0; i < g->n; i++)
+        for (e = g->first[i]; e < g->first[i + 1]; e++)
+            rg->to[fill[g->to[e]]++] = (uint32_t) i;
+    talloc_free(fill);
+    return rg;
+}
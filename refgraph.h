@@ -0,0 +1,83 @@
+/*
+   compressed sparse row graph of references between heap objects
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PHAT_REFGRAPH_H
+#define PHAT_REFGRAPH_H
+#include <stdint.h>
+#include <stddef.h>
+#include "talloc.h"
+
+/*
+   The references of node i are to[first[i]] .. to[first[i + 1] - 1], in
+   the order they were added, so a traversal runs over two flat arrays.
+   The edges are built by runs, each over a range of nodes in order, that
+   can be filled side by side and are joined at the end.
+*/
+struct refgraph {
+    size_t n;                   // nodes
+    uint64_t *first;            // n + 1 edge numbers
+    uint32_t *to;
+    uint64_t nedges;
+};
+
+struct refrun {                 // edges of nodes [lo, hi), being built
+    uint32_t lo, hi, next;
+    uint32_t *to;
+    size_t n, max;
+};
+
+/* make a graph of n nodes, with no edges until refgraph_join() */
+struct refgraph *refgraph_create(TALLOC_CTX *memctx, size_t n);
+
+/* set up a run over nodes [lo, hi) */
+void refrun_start(struct refrun *r, uint32_t lo, uint32_t hi);
+
+/* the slow path of refrun_add */
+void refrun_grow(struct refrun *r);
+
+/* start the edges of node from, nodes of a run are started in order */
+static inline void
+refrun_node(struct refgraph *g, struct refrun *r, uint32_t from)
+{
+    while (r->next <= from)
+        g->first[r->next++] = r->n;
+}
+
+/* add an edge from the node started last */
+static inline void
+refrun_add(struct refrun *r, uint32_t to)
+{
+    if (r->n == r->max)
+        refrun_grow(r);
+    r->to[r->n++] = to;
+}
+
+/* move the edges of nruns runs, which cover every node in order, into g */
+void refgraph_join(struct refgraph *g, struct refrun *runs, int nruns);
+
+/* make the graph of the same nodes with every edge turned around,
+   the edges into a node are in the order of the nodes they come from */
+struct refgraph *refgraph_reverse(TALLOC_CTX *memctx, const struct refgraph *g);
+
+static inline uint64_t
+refgraph_degree(const struct refgraph *g, uint32_t i)
+{
+    return g->first[i + 1] - g->first[i];
+}
+
+#endif /* PHAT_REFGRAPH_H */
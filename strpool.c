@@ -0,0 +1,154 @@
+/*
+   append only pool of interned strings
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "strpool.h"
+
+#define STRPOOL_MIN_SLOTS 1024
+
+static uint32_t
+strpool_hash(const char *s, size_t n)
+{
+    uint32_t h = 0x811c9dc5;
+
+    while (n--) {
+        h ^= (unsigned char) *s++;
+        h *= 0x01000193;
+    }
+    return h;
+}
+
+static void
+strpool_alloc(struct strpool *sp, size_t nslots)
+{
+    sp->slots = talloc_zero_array(sp, struct strpool_slot, nslots);
+    if (NULL == sp->slots) {
+        fprintf(stderr, "strpool: cannot allocate %zu slots\n", nslots);
+        exit(1);
+    }
+    sp->mask = nslots - 1;
+}
+
+static void
+strpool_grow(struct strpool *sp)
+{
+    struct strpool_slot *old = sp->slots;
+    size_t i, h, oslots = sp->mask + 1;
+
+    strpool_alloc(sp, 2 * oslots);
+    for (i = 0; i < oslots; i++) {
+        if (0 == old[i].h1)
+            continue;
+        for (h = old[i].hash & sp->mask; sp->slots[h].h1; h = (h + 1) & sp->mask)
+            ;
+        sp->slots[h] = old[i];
+    }
+    talloc_free(old);
+}
+
+// the handle the next string gets, fill bytes into the last chunk
+static inline size_t
+strpool_top(const struct strpool *sp)
+{
+    return sp->nchunks ? (sp->nchunks - 1) * STRPOOL_CHUNK + sp->fill : 0;
+}
+
+struct strpool *
+strpool_create(TALLOC_CTX *memctx)
+{
+    struct strpool *sp = talloc_zero(memctx, struct strpool);
+
+    if (NULL == sp) {
+        fprintf(stderr, "Failed to allocate memory for strpool\n");
+        return NULL;
+    }
+    strpool_alloc(sp, STRPOOL_MIN_SLOTS);
+    strpool_intern(sp, "", 0);          // handle 0
+    return sp;
+}
+
+char *
+strpool_stage(struct strpool *sp, size_t n)
+{
+    size_t k, i;
+    char *run;
+
+    if (sp->nchunks && sp->fill + n + 1 <= STRPOOL_CHUNK)
+        return strpool_str(sp, (uint32_t) strpool_top(sp));
+
+    // start a new run of chunks, the tail of the last one is given up
+    k = (n + 1 + STRPOOL_CHUNK - 1) / STRPOOL_CHUNK;
+    if ((sp->nchunks + k) << STRPOOL_SHIFT > (size_t) UINT32_MAX) {
+        fprintf(stderr, "strpool: more than 4GB of strings\n");
+        exit(1);
+    }
+    if (sp->nchunks + k > sp->maxchunks) {
+        while (sp->nchunks + k > sp->maxchunks)
+            sp->maxchunks = sp->maxchunks ? 2 * sp->maxchunks : 16;
+        sp->chunks = talloc_realloc(sp, sp->chunks, char *, sp->maxchunks);
+    }
+    if (NULL == (run = (char *) talloc_size(sp, k * STRPOOL_CHUNK))) {
+        fprintf(stderr, "strpool: cannot allocate %zu bytes\n", k * STRPOOL_CHUNK);
+        exit(1);
+    }
+    // a long string runs on into the chunk numbers after the one it
+    // starts in, strpool_commit counts them in
+    for (i = 0; i < k; i++)
+        sp->chunks[sp->nchunks + i] = run + i * STRPOOL_CHUNK;
+    sp->nchunks++;
+    sp->fill = 0;
+    return run;
+}
+
+uint32_t
+strpool_commit(struct strpool *sp, size_t n)
+{
+    uint32_t top = (uint32_t) strpool_top(sp);
+    char *s = strpool_str(sp, top);
+    uint32_t hash = strpool_hash(s, n);
+    size_t h, used;
+
+    s[n] = '\0';
+    for (h = hash & sp->mask; sp->slots[h].h1; h = (h + 1) & sp->mask) {
+        uint32_t old = sp->slots[h].h1 - 1;
+        if (hash == sp->slots[h].hash && 0 == memcmp(strpool_str(sp, old), s, n + 1))
+            return old;
+    }
+    sp->slots[h].hash = hash;
+    sp->slots[h].h1 = top + 1;
+
+    // step over the string, the chunks it runs on into become part of the pool
+    used = sp->fill + n + 1;
+    sp->nchunks += (used - 1) / STRPOOL_CHUNK;
+    sp->fill = (used - 1) % STRPOOL_CHUNK + 1;
+
+    // keep the load under 3/4 so probe runs stay short
+    if (4 * ++sp->count > 3 * (sp->mask + 1))
+        strpool_grow(sp);
+    return top;
+}
+
+uint32_t
+strpool_intern(struct strpool *sp, const char *s, size_t n)
+{
+    memcpy(strpool_stage(sp, n), s, n);
+    return strpool_commit(sp, n);
+}
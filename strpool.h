@@ -0,0 +1,67 @@
+/*
+   append only pool of interned strings
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PHAT_STRPOOL_H
+#define PHAT_STRPOOL_H
+#include <stdint.h>
+#include <stddef.h>
+#include "talloc.h"
+
+/*
+   Strings are kept NUL terminated, back to back, in chunks that never
+   move, so a string's address stays good for the life of the pool.  A
+   string is named by a 32-bit handle, its offset from the start of the
+   pool as if the chunks were one.  A string never straddles two chunks;
+   one longer than a chunk gets a run of chunk numbers of its own.
+   Every string is in the pool once, handle 0 is the empty string.
+*/
+#define STRPOOL_SHIFT 20
+#define STRPOOL_CHUNK ((size_t) 1 << STRPOOL_SHIFT)
+
+struct strpool_slot {
+    uint32_t hash;
+    uint32_t h1;                // handle + 1, 0 for an empty slot
+};
+
+struct strpool {
+    char **chunks;
+    size_t nchunks, maxchunks;
+    size_t fill;                // bytes used in the last chunk
+    struct strpool_slot *slots; // intern table
+    size_t mask, count;
+};
+
+/* create a pool */
+struct strpool *strpool_create(TALLOC_CTX *memctx);
+
+/* room for n bytes at the end of the pool, fill it in and strpool_commit() it */
+char *strpool_stage(struct strpool *sp, size_t n);
+
+/* intern the n bytes that were staged and return the handle of the string */
+uint32_t strpool_commit(struct strpool *sp, size_t n);
+
+/* intern n bytes */
+uint32_t strpool_intern(struct strpool *sp, const char *s, size_t n);
+
+static inline char *
+strpool_str(const struct strpool *sp, uint32_t h)
+{
+    return sp->chunks[h >> STRPOOL_SHIFT] + (h & (STRPOOL_CHUNK - 1));
+}
+
+#endif /* PHAT_STRPOOL_H */
@@ -0,0 +1,188 @@
+/*
+   run independent jobs on a set of worker threads
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "tpool.h"
+
+struct tpool {
+    void (*func)(void *arg, int job);
+    void *arg;
+    int njobs;
+    int next;                   // next job to hand out
+    // for tpool_start, the jobs posted so far are 0 .. njobs-1
+    pthread_mutex_t lock;
+    pthread_cond_t more;
+    pthread_cond_t idle;        // a job finished
+    int finished;
+    int closed;                 // no more jobs will be posted
+    pthread_t *tids;
+    int started;
+};
+
+int
+tpool_ncpu(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return 0 < n ? (int) n : 1;
+}
+
+static void *
+tpool_worker(void *arg)
+{
+    struct tpool *tp = (struct tpool *) arg;
+    int job;
+
+    while ((job = __sync_fetch_and_add(&tp->next, 1)) < tp->njobs)
+        (*tp->func)(tp->arg, job);
+    return NULL;
+}
+
+void
+tpool_run(int nthreads, int njobs, void (*func)(void *arg, int job), void *arg)
+{
+    struct tpool tp;
+    pthread_t *tids;
+    int i, started;
+
+    tp.func = func;
+    tp.arg = arg;
+    tp.njobs = njobs;
+    tp.next = 0;
+
+    if (nthreads > njobs)
+        nthreads = njobs;
+    if (1 >= nthreads) {
+        tpool_worker(&tp);
+        return;
+    }
+
+    tids = (pthread_t *) malloc(sizeof(pthread_t) * nthreads);
+    for (started = 0; started < nthreads - 1; started++) {
+        if (0 != pthread_create(tids + started, NULL, tpool_worker, &tp)) {
+            fprintf(stderr, "tpool_run: cannot start thread %d, continuing with %d\n", started, started + 1);
+            break;
+        }
+    }
+    tpool_worker(&tp);          // the caller works too
+    for (i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+    free(tids);
+}
+
+static void *
+tpool_waiter(void *arg)
+{
+    struct tpool *tp = (struct tpool *) arg;
+    int job;
+
+    pthread_mutex_lock(&tp->lock);
+    for (;;) {
+        if (tp->next < tp->njobs) {
+            job = tp->next++;
+            pthread_mutex_unlock(&tp->lock);
+            (*tp->func)(tp->arg, job);
+            pthread_mutex_lock(&tp->lock);
+            tp->finished++;
+            pthread_cond_broadcast(&tp->idle);
+        } else if (tp->closed)
+            break;
+        else
+            pthread_cond_wait(&tp->more, &tp->lock);
+    }
+    pthread_mutex_unlock(&tp->lock);
+    return NULL;
+}
+
+struct tpool *
+tpool_start(int nthreads, void (*func)(void *arg, int job), void *arg)
+{
+    struct tpool *tp = (struct tpool *) calloc(1, sizeof(struct tpool));
+
+    if (NULL == tp) {
+        fprintf(stderr, "tpool_start: cannot allocate the pool\n");
+        exit(1);
+    }
+    tp->func = func;
+    tp->arg = arg;
+    pthread_mutex_init(&tp->lock, NULL);
+    pthread_cond_init(&tp->more, NULL);
+    pthread_cond_init(&tp->idle, NULL);
+
+    if (1 < nthreads)
+        tp->tids = (pthread_t *) malloc(sizeof(pthread_t) * nthreads);
+    for (tp->started = 0; tp->started < nthreads - 1; tp->started++) {
+        if (0 != pthread_create(tp->tids + tp->started, NULL, tpool_waiter, tp)) {
+            fprintf(stderr, "tpool_start: cannot start thread %d, continuing with %d\n", tp->started, tp->started + 1);
+            break;
+        }
+    }
+    return tp;
+}
+
+void
+tpool_post(struct tpool *tp, int njobs)
+{
+    pthread_mutex_lock(&tp->lock);
+    tp->njobs = njobs;
+    pthread_cond_broadcast(&tp->more);
+    pthread_mutex_unlock(&tp->lock);
+}
+
+void
+tpool_wait(struct tpool *tp, int pending)
+{
+    int job;
+
+    pthread_mutex_lock(&tp->lock);
+    while (tp->njobs - tp->finished > pending) {
+        if (tp->next < tp->njobs) {
+            job = tp->next++;
+            pthread_mutex_unlock(&tp->lock);
+            (*tp->func)(tp->arg, job);
+            pthread_mutex_lock(&tp->lock);
+            tp->finished++;
+            pthread_cond_broadcast(&tp->idle);
+        } else
+            pthread_cond_wait(&tp->idle, &tp->lock);
+    }
+    pthread_mutex_unlock(&tp->lock);
+}
+
+void
+tpool_finish(struct tpool *tp)
+{
+    int i;
+
+    pthread_mutex_lock(&tp->lock);
+    tp->closed = 1;
+    pthread_cond_broadcast(&tp->more);
+    pthread_mutex_unlock(&tp->lock);
+
+    tpool_waiter(tp);           // the caller works too
+    for (i = 0; i < tp->started; i++)
+        pthread_join(tp->tids[i], NULL);
+    pthread_cond_destroy(&tp->more);
+    pthread_cond_destroy(&tp->idle);
+    pthread_mutex_destroy(&tp->lock);
+    free(tp->tids);
+    free(tp);
+}
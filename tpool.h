@@ -0,0 +1,46 @@
+/*
+   run independent jobs on a set of worker threads
+
+   Copyright (C) agent  2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PHAT_TPOOL_H
+#define PHAT_TPOOL_H
+
+/* number of threads to use when the user did not ask for a count */
+int tpool_ncpu(void);
+
+/*
+   Call func(arg, job) for job 0 .. njobs-1 on up to nthreads threads.
+   Jobs are handed out in order as threads become free, and tpool_run
+   returns once every job has finished.  With one thread, or one job,
+   everything runs on the calling thread.
+*/
+void tpool_run(int nthreads, int njobs, void (*func)(void *arg, int job), void *arg);
+
+/*
+   For jobs that are found one at a time.  tpool_start starts up to
+   nthreads - 1 threads that wait for jobs, tpool_post lets jobs 0 ..
+   njobs-1 be handed out, and tpool_finish has the calling thread work
+   through what is left with them and returns once every job posted
+   has finished.  tpool_wait has the calling thread work along until no
+   more than pending of the jobs posted are unfinished.
+*/
+struct tpool *tpool_start(int nthreads, void (*func)(void *arg, int job), void *arg);
+void tpool_post(struct tpool *tp, int njobs);
+void tpool_wait(struct tpool *tp, int pending);
+void tpool_finish(struct tpool *tp);
+
+#endif /* PHAT_TPOOL_H */